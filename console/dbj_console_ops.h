@@ -5,6 +5,8 @@
 #include "../core/dbj_traits.h"
 #include "../core/dbj_buf.h"
 #include "../core/dbj_buffer.h"
+#include "../core/dbj_buf_chain.h"
+#include "../core/dbj_format.h"
 #include "dbj_console.h"
 
 // for out-putting std::path and friends
@@ -332,9 +334,9 @@ with reference or pointer type argument.
 	// fundamental types ********************************************************************************
 	template<> inline void out<nullptr_t>(nullptr_t) { DBJ_TYPE_REPORT_FUNCSIG; PRN.printf("null"); }
 	// fundamental - floating point types
-	template<> inline void out<float>(float fv) { DBJ_TYPE_REPORT_FUNCSIG; PRN.printf("%f", fv); }
-	template<> inline void out<double>(double fv) { DBJ_TYPE_REPORT_FUNCSIG; PRN.printf("%f", fv); }
-	template<> inline void out<long double>(long double fv) { DBJ_TYPE_REPORT_FUNCSIG; PRN.printf("%f", fv); }
+	template<> inline void out<float>(float fv) { DBJ_TYPE_REPORT_FUNCSIG; PRN.char_to_console(::dbj::fmt::float_to_chars(fv).data); }
+	template<> inline void out<double>(double fv) { DBJ_TYPE_REPORT_FUNCSIG; PRN.char_to_console(::dbj::fmt::float_to_chars(fv).data); }
+	template<> inline void out<long double>(long double fv) { DBJ_TYPE_REPORT_FUNCSIG; PRN.char_to_console(::dbj::fmt::float_to_chars(fv).data); }
 	// fundamental - integral types
 	template<> inline void out<bool>(bool bv) { DBJ_TYPE_REPORT_FUNCSIG; PRN.printf("%s", (bv ? "true" : "false")); }
 	// char types are integral types too
@@ -526,6 +528,22 @@ with reference or pointer type argument.
 		);
 	}
 
+	/*
+	all the segments are widened into one wstring
+	and written to the console in one go
+	same as char_to_console() that is only ASCII aware
+	*/
+	inline void out(::dbj::buf::chain const & chain_)
+	{
+		if (chain_.empty()) return;
+		std::wstring wide_;
+		wide_.reserve(chain_.size());
+		chain_.for_each([&](std::string_view segment_) {
+			wide_.append(segment_.begin(), segment_.end());
+		});
+		PRN.cons().out(wide_.data(), wide_.data() + wide_.size());
+	}
+
 #pragma region error codes and options
 	// we can not place a friend inside std::error_code, so...
 	// using namespace dbj::console;
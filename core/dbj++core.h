@@ -13,7 +13,11 @@
 #include "dbj_insider.h"
 #include "dbj_buf.h"
 #include "dbj_buffer.h"
+#include "dbj_bytes.h"
+#include "dbj_buf_chain.h"
+#include "dbj_buf_large.h"
 #include "dbj_format.h"
+#include "dbj_format_ct.h"
 #include "dbj_core_utils.h"
 
 #endif DBJ_CORE_INCLUDED
@@ -0,0 +1,198 @@
+#pragma once
+
+#include "../dbj_gpl_license.h"
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <memory_resource>
+
+/*
+2019-03-16	dbj@dbj.org	created
+
+monotonic arena aka the bump allocator
+
+for request scoped work, all the buffers made during one unit of work
+are made in one arena. nothing is freed one by one, everything is
+freed at once by arena::reset() or by the arena destructor.
+
+	dbj::buf::arena arena_ ;
+	{
+		auto b1 = dbj::buf::smart_buf<char>::make( arena_, "payload" ) ;
+		// standard containers can use the same arena
+		std::pmr::vector<int> ints_( arena_.resource() ) ;
+		...
+	} // b1 and ints_ are gone
+	arena_.reset() ;
+
+buffers made in the arena do not free anything, their control blocks
+are on the heap, thus a buffer destroyed after the reset is harmless
+but its payload must not be used after the reset
+
+note: arena is not MT safe, it is meant to be used from one thread
+*/
+namespace dbj {
+	namespace buf {
+
+		class arena final
+		{
+			// chunk header, the memory handed out follows it
+			struct chunk final {
+				chunk * next{};
+				std::size_t size{}; // without the header
+			};
+
+			constexpr static std::size_t header_size =
+				(sizeof(chunk) + alignof(std::max_align_t) - 1)
+				& ~(alignof(std::max_align_t) - 1);
+
+			// most recent, and the largest chunk is the head
+			chunk * head_{};
+			std::byte * current_{};
+			std::byte * end_{};
+			std::size_t next_chunk_size_{};
+
+			static std::byte * chunk_begin(chunk * c_) noexcept {
+				return reinterpret_cast<std::byte *>(c_) + header_size;
+			}
+
+			bool add_chunk(std::size_t min_size_) noexcept
+			{
+				std::size_t size_ = next_chunk_size_;
+				while (size_ < min_size_) size_ *= 2;
+
+				void * block_ = std::malloc(header_size + size_);
+				if (!block_) return false;
+
+				chunk * chunk_ = ::new (block_) chunk{ head_, size_ };
+				head_ = chunk_;
+				current_ = chunk_begin(chunk_);
+				end_ = current_ + size_;
+				// geometric growth
+				next_chunk_size_ = size_ * 2;
+				return true;
+			}
+
+			void release_chunks(chunk * from_) noexcept
+			{
+				while (from_) {
+					chunk * next_ = from_->next;
+					std::free(from_);
+					from_ = next_;
+				}
+			}
+
+			/*
+			the adapter for the std::pmr containers
+			deallocation does nothing, as ever with the arena
+			*/
+			class resource_type final : public std::pmr::memory_resource
+			{
+				arena & arena_;
+			public:
+				explicit resource_type(arena & arena_ref_) noexcept
+					: arena_(arena_ref_) {}
+			private:
+				void * do_allocate(std::size_t bytes_, std::size_t align_) override
+				{
+					void * p_ = arena_.allocate(bytes_, align_);
+					if (!p_) throw std::bad_alloc();
+					return p_;
+				}
+
+				void do_deallocate(void *, std::size_t, std::size_t) noexcept override
+				{
+				}
+
+				bool do_is_equal(const std::pmr::memory_resource & other_) const noexcept override
+				{
+					return this == &other_;
+				}
+			} resource_{ *this };
+
+		public:
+			// posix BUFSIZ * 8
+			constexpr static std::size_t default_chunk_size = 0x1000;
+
+			explicit arena(std::size_t first_chunk_size_ = default_chunk_size) noexcept
+				: next_chunk_size_(first_chunk_size_ > 0 ? first_chunk_size_ : default_chunk_size)
+			{
+			}
+
+			~arena() { release_chunks(head_); }
+
+			// arena is where the memory is, it is not to be copied or moved
+			arena(arena const &) = delete;
+			arena & operator = (arena const &) = delete;
+			arena(arena &&) = delete;
+			arena & operator = (arena &&) = delete;
+
+			/*
+			returns nullptr only if the system is out of memory
+			align_ must be the power of 2
+			*/
+			[[nodiscard]] void * allocate(
+				std::size_t bytes_,
+				std::size_t align_ = alignof(std::max_align_t)
+			) noexcept
+			{
+				assert(align_ > 0 && ((align_ & (align_ - 1)) == 0));
+
+				auto aligned_ = [&]() noexcept -> std::byte * {
+					if (!current_) return nullptr;
+					std::uintptr_t p_ = reinterpret_cast<std::uintptr_t>(current_);
+					p_ = (p_ + align_ - 1) & ~(std::uintptr_t(align_) - 1);
+					std::byte * rezult_ = reinterpret_cast<std::byte *>(p_);
+					if (rezult_ + bytes_ > end_) return nullptr;
+					return rezult_;
+				};
+
+				std::byte * rezult_ = aligned_();
+				if (!rezult_) {
+					if (!add_chunk(bytes_ + align_)) return nullptr;
+					rezult_ = aligned_();
+					assert(rezult_);
+				}
+				current_ = rezult_ + bytes_;
+				return rezult_;
+			}
+
+			/*
+			everything allocated so far is gone
+			the largest chunk is kept for the next unit of work
+			*/
+			void reset() noexcept
+			{
+				if (!head_) return;
+				release_chunks(head_->next);
+				head_->next = nullptr;
+				current_ = chunk_begin(head_);
+				end_ = current_ + head_->size;
+			}
+
+			// bytes available in all the chunks
+			std::size_t capacity() const noexcept
+			{
+				std::size_t total_{};
+				for (chunk * walker_ = head_; walker_; walker_ = walker_->next)
+					total_ += walker_->size;
+				return total_;
+			}
+
+			// for std::pmr containers and allocators
+			std::pmr::memory_resource * resource() noexcept { return &resource_; }
+
+			/*
+			deleter for the things made in the arena
+			they are released all at once, by the arena
+			*/
+			struct no_release final {
+				template<typename T>
+				void operator () (T *) const noexcept {}
+			};
+		}; // arena
+
+	} // buf
+} // dbj
@@ -4,15 +4,21 @@
 
 #include "../dbj_gpl_license.h"
 #include "dbj_insider.h"
+#include "dbj_arena.h"
+#include "dbj_pool.h"
+#include "dbj_buf_kernels.h"
 
 #include <system_error>
 #include <cassert>
 #include <memory>
+#include <new>
 #include <string_view>
 #include <type_traits>
 #include <cstdint>
 #include <cstddef>
 #include <cstring>
+#include <cstdlib>
+#include <algorithm>
 
 // makes stremaing related operators 
 // on dbj buffer types
@@ -52,8 +58,303 @@ namespace dbj {
 		yanb_t<char>::type
 		*/
 
+#pragma region allocation policies
+		/*
+		allocation policy is what makes the heap blocks for yanb_t
+		count_ chars are allocated, they are not initialized
+		*/
+		struct heap_allocation final
+		{
+			// of the blocks made
+			constexpr static std::size_t alignment = alignof(std::max_align_t);
+			// bytes after the payload, safe to read
+			constexpr static std::size_t padding = 0;
+
+			template<typename C>
+			static std::shared_ptr<C> block(std::size_t count_) noexcept
+			{
+				C * block_ = static_cast<C *>(std::malloc(count_ * sizeof(C)));
+				assert(block_);
+				return std::shared_ptr<C>(block_, std::free);
+			}
+
+			// raw blocks, for the non shared ownership policies
+			static void * allocate(std::size_t bytes_) noexcept { return std::malloc(bytes_); }
+			static void deallocate(void * block_, std::size_t) noexcept { std::free(block_); }
+		};
+
+		/*
+		#define DBJ_BUF_POOLED to have all the dbj buffers
+		allocated from and freed into the thread local size_class_pool
+		*/
+#ifdef DBJ_BUF_POOLED
+		using default_allocation = pooled_allocation;
+#else
+		using default_allocation = heap_allocation;
+#endif
+
+		/*
+		2019-03-29	dbj@dbj.org
+
+		for the SIMD consumers: blocks are aligned to ALIGN bytes
+		and followed by at least ALIGN zeroed bytes, thus one vector
+		can be loaded from anywhere before the end of the payload
+
+		NOTE! short payloads are not kept in the instance (no SSO)
+		when made by smart_buf<CHAR, aligned_allocation<ALIGN>>
+		growing them later, by reserve() or reset(), is done with
+		the default_allocation, thus aligned payloads are for the
+		"make once, read many times" scenarios
+		*/
+		template<std::size_t ALIGN>
+		struct aligned_allocation final
+		{
+			static_assert(ALIGN == 16 || ALIGN == 32 || ALIGN == 64,
+				"aligned_allocation: ALIGN must be 16, 32 or 64");
+
+			constexpr static std::size_t alignment = ALIGN;
+			constexpr static std::size_t padding = ALIGN;
+
+			// rounded up to the ALIGN and padded
+			static std::size_t padded_size(std::size_t bytes_) noexcept
+			{
+				return ((bytes_ + ALIGN - 1) & ~(ALIGN - 1)) + padding;
+			}
+
+			// the tail is zeroed, the payload is not initialized
+			static void * allocate(std::size_t bytes_) noexcept
+			{
+				const std::size_t padded_ = padded_size(bytes_);
+#ifdef _MSC_VER
+				void * block_ = ::_aligned_malloc(padded_, ALIGN);
+#else
+				void * block_ = std::aligned_alloc(ALIGN, padded_);
+#endif
+				if (block_)
+					std::memset(static_cast<char *>(block_) + bytes_, 0, padded_ - bytes_);
+				return block_;
+			}
+
+			static void deallocate(void * block_, std::size_t) noexcept
+			{
+#ifdef _MSC_VER
+				::_aligned_free(block_);
+#else
+				std::free(block_);
+#endif
+			}
+
+			template<typename C>
+			static std::shared_ptr<C> block(std::size_t count_) noexcept
+			{
+				C * block_ = static_cast<C *>(allocate(count_ * sizeof(C)));
+				assert(block_);
+				return std::shared_ptr<C>(block_,
+					[](C * p_) noexcept { deallocate(p_, 0); });
+			}
+		};
+
+		// true if the payload is aligned to ALIGN
+		template<std::size_t ALIGN, typename C>
+		inline bool is_aligned(C const * payload_) noexcept
+		{
+			return 0 == (reinterpret_cast<std::uintptr_t>(payload_) & (ALIGN - 1));
+		}
+#pragma endregion allocation policies
+
+#pragma region ownership policies
+		/*
+		2019-03-27	dbj@dbj.org
+
+		ownership policy decides what is the yanb_t heap block handle
+
+		shared_ownership -- std::shared_ptr, atomic reference count
+							 the default, as before
+		unique_ownership -- std::unique_ptr, yanb_t is move only
+		local_ownership  -- dbj::buf::local_ptr, intrusive and *not* atomic
+							 reference count, copies are cheap but they
+							 must not leave the thread that made them
+
+		policy has:
+			template<typename C> using handle = ... ;
+			template<typename C, typename ALLOCATION> static handle<C> block(count_) ;
+			template<typename C> static long use_count(handle<C> const &) ;
+		*/
+		struct shared_ownership final
+		{
+			template<typename C>
+			using handle = std::shared_ptr<C>;
+
+			template<typename C, typename ALLOCATION>
+			static handle<C> block(std::size_t count_) noexcept
+			{
+				return ALLOCATION::template block<C>(count_);
+			}
+
+			template<typename C>
+			static long use_count(handle<C> const & handle_) noexcept
+			{
+				return handle_.use_count();
+			}
+		};
+
+		// the deleter which knows the allocation policy used
+		struct release_block final
+		{
+			void(*release)(void *, std::size_t) {};
+			std::size_t bytes{};
+
+			template<typename C>
+			void operator () (C * block_) const noexcept
+			{
+				if (block_) release(block_, bytes);
+			}
+		};
+
+		struct unique_ownership final
+		{
+			template<typename C>
+			using handle = std::unique_ptr<C, release_block>;
+
+			template<typename C, typename ALLOCATION>
+			static handle<C> block(std::size_t count_) noexcept
+			{
+				const std::size_t bytes_ = count_ * sizeof(C);
+				C * block_ = static_cast<C *>(ALLOCATION::allocate(bytes_));
+				assert(block_);
+				return handle<C>(block_, release_block{ &ALLOCATION::deallocate, bytes_ });
+			}
+
+			template<typename C>
+			static long use_count(handle<C> const & handle_) noexcept
+			{
+				return handle_ ? 1 : 0;
+			}
+		};
+
+		/*
+		the header with the count is in front of the payload
+		one allocation, one pointer in the instance
+		no atomics, no control block
+		*/
+		template<typename C>
+		class local_ptr final
+		{
+			/*
+			header is right in front of the payload
+			front is from the block start to the payload, so that
+			the payload is aligned as the allocation policy requires
+			*/
+			struct header final {
+				std::size_t refs;
+				std::size_t bytes;
+				std::size_t front;
+				void(*release)(void *, std::size_t);
+			};
+
+			header * head_{};
+
+			void release_() noexcept
+			{
+				if (head_ && (0 == --head_->refs)) {
+					char * block_ = reinterpret_cast<char *>(head_ + 1) - head_->front;
+					head_->release(block_, head_->bytes);
+				}
+				head_ = nullptr;
+			}
+
+		public:
+			using element_type = C;
+
+			local_ptr() noexcept = default;
+
+			template<typename ALLOCATION>
+			static local_ptr make(std::size_t count_) noexcept
+			{
+				constexpr std::size_t align_ = ALLOCATION::alignment;
+				constexpr std::size_t front_ = (sizeof(header) + align_ - 1) & ~(align_ - 1);
+				const std::size_t bytes_ = front_ + count_ * sizeof(C);
+				char * block_ = static_cast<char *>(ALLOCATION::allocate(bytes_));
+				assert(block_);
+				local_ptr retval_{};
+				retval_.head_ = ::new (block_ + front_ - sizeof(header))
+					header{ 1, bytes_, front_, &ALLOCATION::deallocate };
+				return retval_;
+			}
+
+			~local_ptr() { release_(); }
+
+			local_ptr(local_ptr const & other_) noexcept
+				: head_(other_.head_)
+			{
+				if (head_) ++head_->refs;
+			}
+
+			local_ptr & operator = (local_ptr const & other_) noexcept
+			{
+				local_ptr temp_(other_);
+				this->swap(temp_);
+				return *this;
+			}
+
+			local_ptr(local_ptr && other_) noexcept { this->swap(other_); }
+
+			local_ptr & operator = (local_ptr && other_) noexcept
+			{
+				local_ptr temp_(std::move(other_));
+				this->swap(temp_);
+				return *this;
+			}
+
+			void swap(local_ptr & other_) noexcept { std::swap(head_, other_.head_); }
+
+			void reset() noexcept { release_(); }
+
+			C * get() const noexcept {
+				return head_ ? reinterpret_cast<C *>(head_ + 1) : nullptr;
+			}
+
+			long use_count() const noexcept {
+				return head_ ? static_cast<long>(head_->refs) : 0;
+			}
+
+			explicit operator bool() const noexcept { return head_ != nullptr; }
+		};
+
+		struct local_ownership final
+		{
+			template<typename C>
+			using handle = local_ptr<C>;
+
+			template<typename C, typename ALLOCATION>
+			static handle<C> block(std::size_t count_) noexcept
+			{
+				return handle<C>::template make<ALLOCATION>(count_);
+			}
+
+			template<typename C>
+			static long use_count(handle<C> const & handle_) noexcept
+			{
+				return handle_.use_count();
+			}
+		};
+#pragma endregion ownership policies
+
+		/*
+		2019-03-12	dbj@dbj.org	SSO added
+
+		payloads up to yanb_sso_length chars are kept inside the instance
+		no heap allocation for them at all
+		longer payloads are on the heap in a single allocation
+		length is always stored, thus size() is O(1)
+		*/
+		constexpr inline std::size_t yanb_sso_length = 23;
+
+		template<typename T> struct yanb_slice_t;
+
 		template<
 			typename T,
+			typename OWNERSHIP = shared_ownership,
 			std::enable_if_t<
 			std::is_same_v<char, T> ||
 			std::is_same_v<wchar_t, T>
@@ -63,73 +364,244 @@ namespace dbj {
 		{
 			using type = yanb_t;
 			using data_type = T;
-			using value_type = std::shared_ptr<data_type>;
+			using ownership = OWNERSHIP;
+			using value_type = typename ownership::template handle<data_type>;
 			using value_type_ref = std::reference_wrapper<value_type>;
 
+			constexpr static std::size_t sso_length = yanb_sso_length;
+
 			struct inner final {
 
-				static void set_payload(
-					std::reference_wrapper< std::shared_ptr<char> > storage_ref,
-					char const * payload_
-				) {
+				static size_t length(char const * payload_) noexcept {
 					assert(payload_ != nullptr);
-					storage_ref.get().reset(_strdup(payload_));
+					return std::strlen(payload_);
 				}
 
-				static void set_payload(
-					std::reference_wrapper< std::shared_ptr<wchar_t> > storage_ref,
-					wchar_t const * payload_
-				) {
+				static size_t length(wchar_t const * payload_) noexcept {
 					assert(payload_ != nullptr);
-					storage_ref.get().reset(_wcsdup(payload_));
+					return std::wcslen(payload_);
+				}
+
+				// length up to the first '\0' but not beyond max_
+				// for char arrays which are not guaranteed to be zero terminated
+				static size_t length(data_type const * payload_, size_t max_) noexcept {
+					assert(payload_ != nullptr);
+					return std::distance(payload_,
+						std::find(payload_, payload_ + max_, data_type(0)));
 				}
 				/*--------------------------------------------------------*/
-				static size_t length(
-					std::reference_wrapper< std::shared_ptr<char> > storage_ref
-				) {
-					assert(storage_ref.get());
-					return (std::strlen(storage_ref.get().get()));
+				// one allocation, one copy, zero terminated
+				// capacity_ chars are allocated, size_ are used
+				template<typename ALLOCATION = default_allocation>
+				static value_type duplicate(
+					data_type const * payload_, size_t size_, size_t capacity_ = 0
+				) noexcept
+				{
+					capacity_ = (std::max)(size_, capacity_);
+					value_type retval_ = 
+						ownership::template block<data_type, ALLOCATION>(capacity_ + 1);
+					data_type * block_ = retval_.get();
+					if (payload_)
+						std::memcpy(block_, payload_, size_ * sizeof(data_type));
+					else
+						std::memset(block_, 0, (capacity_ + 1) * sizeof(data_type));
+					block_[size_] = data_type(0);
+					return retval_;
 				}
+			}; // inner
+
+			type & reset(data_type const * payload_)
+			{
+				return this->reset(payload_, inner::length(payload_));
+			}
 
-				static size_t length(
-					std::reference_wrapper< std::shared_ptr<wchar_t> > storage_ref
-				) {
-					assert(storage_ref.get());
-					return (std::wcslen(storage_ref.get().get()));
+			/*
+			payload_ might point inside this very instance
+			that is why the order of operations bellow matters
+			*/
+			type & reset(data_type const * payload_, size_t count_)
+			{
+				assert(payload_ != nullptr);
+				if (count_ <= sso_length) {
+					std::memmove(this->sso_, payload_, count_ * sizeof(data_type));
+					this->sso_[count_] = data_type(0);
+					this->data_.reset();
+					this->is_sso_ = true;
+				}
+				else {
+					value_type fresh_ = inner::duplicate(payload_, count_);
+					this->data_.swap(fresh_);
+					this->is_sso_ = false;
+					this->capacity_ = count_;
 				}
+				this->size_ = count_;
+				return *this;
+			}
 
-			}; // inner
+			/*
+			make room for at least count_ chars
+			content and size() are preserved
+			if the heap block is shared with other instances this one 
+			gets its own copy, so that writing into the reserved space 
+			is never seen by the others
+			*/
+			type & reserve(size_t count_)
+			{
+				if (count_ <= this->capacity() && this->unique()) 
+					return *this;
+
+				// default constructed, but short enough to go inline
+				if ((count_ <= sso_length) && !(*this)) {
+					this->sso_[0] = data_type(0);
+					this->size_ = 0;
+					this->is_sso_ = true;
+					return *this;
+				}
 
-			type & reset(data_type const * payload_)
+				value_type fresh_ = inner::duplicate(
+					this->data(), this->size_, count_
+				);
+				this->data_.swap(fresh_);
+				this->is_sso_ = false;
+				this->capacity_ = (std::max)(count_, this->size_);
+				return *this;
+			}
+
+			/*
+			set the size to count_ which must be inside the capacity()
+			char at count_ is set to '\0'
+			content bellow count_ is not touched
+			*/
+			type & resize(size_t count_) noexcept
 			{
-				inner::set_payload(this->data_, payload_);
+				assert(*this);
+				assert(count_ <= this->capacity());
+				this->data()[count_] = data_type(0);
+				this->size_ = count_;
 				return *this;
 			}
 
+			/*
+			take the ownership of the block made elsewhere, no copy
+			block_ must hold capacity_ + 1 chars
+			and it must be zero terminated at size_
+			*/
+			static type adopt(value_type block_, size_t size_, size_t capacity_) noexcept
+			{
+				assert(block_);
+				assert(size_ <= capacity_);
+				assert(block_.get()[size_] == data_type(0));
+				type retval_{};
+				retval_.data_ = std::move(block_);
+				retval_.size_ = size_;
+				retval_.capacity_ = capacity_;
+				return retval_;
+			}
+
 			yanb_t(data_type const * payload_) {
-				inner::set_payload(this->data_, payload_);
+				this->reset(payload_);
+			}
+
+			// payload_ does not have to be zero terminated
+			yanb_t(data_type const * payload_, size_t count_) {
+				this->reset(payload_, count_);
 			}
 
-			size_t size() noexcept { return inner::length(this->data_); }
-			size_t size() const noexcept { return inner::length(this->data_); }
+			// count_ chars, all zeroes
+			// notice: size() of this instance will be count_ not 0
+			explicit yanb_t(size_t count_, data_type)
+				: size_(count_), is_sso_(count_ <= sso_length)
+			{
+				if (!is_sso_) {
+					this->data_ = inner::duplicate(nullptr, count_);
+					this->capacity_ = count_;
+				}
+			}
 
-			data_type * data() noexcept { return this->data_.get(); }
-			data_type const * data() const noexcept { return this->data_.get(); }
+			size_t size() noexcept { return this->size_; }
+			size_t size() const noexcept { return this->size_; }
+
+			// how many chars can be held without reallocation
+			size_t capacity() const noexcept { 
+				return is_sso_ ? sso_length : this->capacity_;
+			}
 
-			operator data_type * () noexcept { return this->data_.get(); }
-			operator data_type const * () const noexcept { return this->data_.get(); }
+			// true if no other instance shares the payload
+			bool unique() const noexcept {
+				return is_sso_ || (ownership::use_count(this->data_) < 2);
+			}
+
+			data_type * data() noexcept { 
+				return is_sso_ ? this->sso_ : this->data_.get(); 
+			}
+			data_type const * data() const noexcept { 
+				return is_sso_ ? this->sso_ : this->data_.get(); 
+			}
 
-			operator bool() noexcept { return data_.operator bool(); }
-			operator bool() const noexcept { return data_.operator bool(); }
+			operator data_type * () noexcept { return this->data(); }
+			operator data_type const * () const noexcept { return this->data(); }
+
+			operator bool() noexcept { return is_sso_ || bool(data_); }
+			operator bool() const noexcept { return is_sso_ || bool(data_); }
+
+			// true if no heap allocation was made
+			bool is_sso() const noexcept { return is_sso_; }
 
 			yanb_t() = default;
+			// deleted for the unique_ownership
 			yanb_t(yanb_t const &) = default;
 			yanb_t& operator = (yanb_t const &) = default;
-			yanb_t(yanb_t &&) = default;
-			yanb_t& operator = (yanb_t &&) = default;
+
+			// moved from instance is left in the default state
+			yanb_t(yanb_t && other_) noexcept {
+				this->swap(other_);
+			}
+
+			yanb_t& operator = (yanb_t && other_) noexcept {
+				if (&other_ != this) {
+					yanb_t temp_{};
+					this->swap(temp_);
+					this->swap(other_);
+				}
+				return *this;
+			}
+
+			// sizes are stored, no strlen() is required
+			friend bool operator == (yanb_t const & left_, yanb_t const & right_) noexcept
+			{
+				if (left_.size() != right_.size())
+					return false;
+				if (left_.size() < 1)
+					return true;
+				return kernels::equal(
+					left_.data(), right_.data(), left_.size() * sizeof(data_type)
+				);
+			}
+
+			friend bool operator != (yanb_t const & left_, yanb_t const & right_) noexcept
+			{
+				return !(left_ == right_);
+			}
+
+			void swap(yanb_t & other_) noexcept {
+				std::swap(this->data_, other_.data_);
+				std::swap(this->sso_, other_.sso_);
+				std::swap(this->size_, other_.size_);
+				std::swap(this->capacity_, other_.capacity_);
+				std::swap(this->is_sso_, other_.is_sso_);
+			}
 
 		private:
+			// slices share the data_
+			friend struct yanb_slice_t<data_type>;
+
 			value_type data_{};
+			// the heap is not used for short payloads
+			data_type sso_[sso_length + 1]{};
+			size_t size_{};
+			// of the heap block
+			size_t capacity_{};
+			bool is_sso_{};
 
 #ifdef DBJ_BUFFERS_IOSTREAMS
 
@@ -171,6 +643,113 @@ namespace dbj {
 		using yanb = yanb_t<char>;
 		using yanwb = yanb_t<wchar_t>;
 
+		// move only
+		using unique_yanb = yanb_t<char, unique_ownership>;
+		using unique_yanwb = yanb_t<wchar_t, unique_ownership>;
+
+		// for single threaded pipelines
+		using local_yanb = yanb_t<char, local_ownership>;
+		using local_yanwb = yanb_t<wchar_t, local_ownership>;
+
+#pragma region yanb slice
+		/*
+		2019-03-20	dbj@dbj.org
+
+		the window [offset, offset + count) of the yanb_t payload
+		no copy is made, the payload is kept alive by the aliasing shared_ptr
+		thus slices can be handed over to other threads
+
+		NOTE! the slice is not zero terminated, use size() or view()
+
+		slices of the short, sso payloads are copied into the slice
+		no heap allocation is made for them either
+		*/
+		template<typename T>
+		struct yanb_slice_t final
+		{
+			using type = yanb_slice_t;
+			using data_type = T;
+			using source_type = typename yanb_t<T>::type;
+			using value_type = std::shared_ptr<data_type const>;
+			using view_type = std::basic_string_view<data_type>;
+
+			constexpr static std::size_t sso_length = source_type::sso_length;
+
+			yanb_slice_t() = default;
+
+			yanb_slice_t(source_type const & source_, size_t offset_, size_t count_) noexcept
+			{
+				assert(source_);
+				assert(offset_ <= source_.size());
+				offset_ = (std::min)(offset_, source_.size());
+				count_ = (std::min)(count_, source_.size() - offset_);
+
+				if (source_.is_sso()) {
+					std::memcpy(this->sso_, source_.data() + offset_, count_ * sizeof(data_type));
+					this->is_sso_ = true;
+				}
+				else {
+					// the aliasing constructor
+					this->data_ = value_type(source_.data_, source_.data() + offset_);
+				}
+				this->size_ = count_;
+			}
+
+			// the whole of the source
+			explicit yanb_slice_t(source_type const & source_) noexcept
+				: yanb_slice_t(source_, 0, source_.size())
+			{}
+
+			// slice of this slice, sharing the same payload
+			type sub(size_t offset_, size_t count_) const noexcept
+			{
+				assert(offset_ <= size_);
+				offset_ = (std::min)(offset_, size_);
+				count_ = (std::min)(count_, size_ - offset_);
+				type retval_{};
+				if (this->is_sso_) {
+					std::memcpy(retval_.sso_, this->sso_ + offset_, count_ * sizeof(data_type));
+					retval_.is_sso_ = true;
+				}
+				else {
+					retval_.data_ = value_type(this->data_, this->data_.get() + offset_);
+				}
+				retval_.size_ = count_;
+				return retval_;
+			}
+
+			data_type const * data() const noexcept {
+				return is_sso_ ? this->sso_ : this->data_.get();
+			}
+			size_t size() const noexcept { return this->size_; }
+			view_type view() const noexcept { return { this->data(), this->size_ }; }
+
+			operator bool() const noexcept { return is_sso_ || data_.operator bool(); }
+
+			// an owning, zero terminated copy
+			source_type to_yanb() const noexcept {
+				assert(*this);
+				return { this->data(), this->size_ };
+			}
+
+		private:
+			value_type data_{};
+			data_type sso_[sso_length + 1]{};
+			size_t size_{};
+			bool is_sso_{};
+		}; // yanb_slice_t<T>
+
+		using yanb_slice = yanb_slice_t<char>;
+		using yanwb_slice = yanb_slice_t<wchar_t>;
+
+		template<typename C>
+		inline yanb_slice_t<C> slice(yanb_t<C> const & source_, size_t offset_, size_t count_)
+			noexcept
+		{
+			return { source_, offset_, count_ };
+		}
+#pragma endregion yanb slice
+
 #ifdef DBJ_YANB_TESTING
 
 		void test_yanb()
@@ -181,6 +760,12 @@ namespace dbj {
 				yanb b2 = b1;
 				DBJ_TEST_ATOM(mover(b2));
 				DBJ_TEST_ATOM(mover("narrow dabra"));
+				// short payloads are not on the heap
+				DBJ_TEST_ATOM(b1.is_sso());
+				DBJ_TEST_ATOM(b1.size());
+				yanb b3("this is a payload longer than the sso length");
+				DBJ_TEST_ATOM(b3.is_sso());
+				DBJ_TEST_ATOM(b3.size());
 			}
 			{
 				auto mover = [](yanwb bufy) { return bufy; };
@@ -228,24 +813,31 @@ namespace dbj {
 
 		// this is basically just set of helpers
 		// to use the buffer from above
-		template<typename CHAR> struct smart_buf final
+		// ALLOCATION is the policy for the heap blocks made
+		// OWNERSHIP is the policy for the yanb_t made
+		template<
+			typename CHAR, 
+			typename ALLOCATION = default_allocation,
+			typename OWNERSHIP = shared_ownership
+		> 
+		struct smart_buf final
 		{
 			using type = smart_buf;
 			using value_type = CHAR;
+			using allocation = ALLOCATION;
+			using ownership = OWNERSHIP;
 
-			using storage_t = yanb_t<CHAR>;
+			using storage_t = yanb_t<CHAR, OWNERSHIP>;
 
 			using pointer = typename storage_t::value_type ;
 			using ref_type = type & ;
 
 			// always use this function to make  
 			// buff of particular size
-			// array is sized & zeroed
+			// array is sized & zeroed, but it is empty
+			// size() of the result is 0 and capacity() is at least size_
 			static storage_t make(inside_1_and_max size_) noexcept {
-				return 
-				{
-				(std::make_unique<value_type[]>(size_ + 1)).get()
-				};
+				return allocate_(nullptr, 0, size_t(size_));
 			}
 
 			static bool
@@ -280,55 +872,111 @@ namespace dbj {
 					first_, std::distance(first_, last_)
 					);
 				assert(sv_.size() > 0);
-				return { sv_.data() }; 
+				return allocate_(sv_.data(), sv_.size());
 			}
 			// here we depend on a zero terminated string
 			static storage_t make(value_type const * first_) noexcept
 			{
 				assert(first_);
-				return { first_ };
+				return allocate_(first_, storage_t::inner::length(first_));
 			}
 			/*	from array of char's	*/
 			template<size_t N>
 			static storage_t make(const value_type(&charr)[N]) noexcept
 			{
-				return { charr };
+				return allocate_(charr, storage_t::inner::length(charr, N));
 			}
 			/* from string_view */
 			static  storage_t	make(std::basic_string_view< value_type > sv_) noexcept
 			{
-				return { sv_.data() };
+				return allocate_(sv_.data(), sv_.size());
 			}
 			/* from string  */
 			static  storage_t	make(std::basic_string< value_type > sv_ )  noexcept
 			{
-				return { sv_.c_str() };
+				return allocate_(sv_.c_str(), sv_.size());
 			}
-			/* from vector  */
+			/* from vector, up to the first '\0' if any */
 			static  storage_t	make(std::vector< value_type > sv_ )  noexcept
 			{
-				return { sv_.data() };
+				return allocate_(sv_.data(), storage_t::inner::length(sv_.data(), sv_.size()));
 			}
-			/* from array  */
+			/* from array, up to the first '\0' if any */
 			template<size_t N>
 			static  storage_t	make(std::array< value_type, N > sv_ )  noexcept
 			{
-				return { sv_.data() };
+				return allocate_(sv_.data(), storage_t::inner::length(sv_.data(), N));
 			}
 
 			/* from An Other */
 			static storage_t make( storage_t another_) noexcept
 			{
 				assert( true == another_);
-				return { another_.data() };
+				return allocate_(another_.data(), another_.size());
 			}
 
+#pragma region arena makers
+			/*
+			2019-03-16	dbj@dbj.org
+
+			the payload is made in the arena, the shared_ptr control block 
+			is not, it is on the heap and its deleter does nothing
+			thus the result can be destroyed after the arena is reset or gone
+			but its payload must not be used after that
+			short payloads are inside the yanb_t, as ever
+			*/
+			static storage_t make(
+				arena & arena_, value_type const * payload_, size_t size_
+			) noexcept
+			{
+				return arena_allocate_(arena_, payload_, size_, size_);
+			}
+
+			// sized and zeroed, but empty
+			// size() of the result is 0 and capacity() is at least size_
+			static storage_t make(arena & arena_, inside_1_and_max size_) noexcept {
+				return arena_allocate_(arena_, nullptr, 0, size_t(size_));
+			}
+
+			static storage_t make(
+				arena & arena_, value_type const * first_, value_type const * last_
+			) noexcept
+			{
+				assert(first_ && last_);
+				return make(arena_, first_, size_t(std::distance(first_, last_)));
+			}
+			/* string literals and std strings go through here too */
+			static  storage_t	make(
+				arena & arena_, std::basic_string_view< value_type > sv_
+			) noexcept
+			{
+				return make(arena_, sv_.data(), sv_.size());
+			}
+			/* from vector, up to the first '\0' if any */
+			static  storage_t	make(
+				arena & arena_, std::vector< value_type > const & sv_
+			)  noexcept
+			{
+				return make(arena_, sv_.data(),
+					storage_t::inner::length(sv_.data(), sv_.size()));
+			}
+			/* from array, up to the first '\0' if any */
+			template<size_t N>
+			static  storage_t	make(
+				arena & arena_, std::array< value_type, N > const & sv_
+			)  noexcept
+			{
+				return make(arena_, sv_.data(), storage_t::inner::length(sv_.data(), N));
+			}
+#pragma endregion arena makers
+
 			/*
 			NOTE! 
-			stringlen on char array filled with 0's returns 0!
-			not the allocated size of the array.
-			if you do not send the size and if it is found to be 0
-			and no fill will be done.
+			size() is the stored length, not the strlen()
+			buffers made by make(size_) are empty, size() is 0
+			if you do not send the N, size() chars are filled
+			N must be inside the capacity(), if N is beyond the size()
+			the size() becomes N
 			*/
 			static  storage_t &
 				fill(
@@ -340,15 +988,82 @@ namespace dbj {
 				assert(buff_);
 				if ( buff_ )
 				{
-					const auto bufsiz_ = buff_.size();
-					N = (N >= 0 ? N : bufsiz_);
-					assert(N <= bufsiz_);
-					::std::fill(buff_.data(), buff_.data() + N, val_);
+					N = (N > 0 ? N : buff_.size());
+					assert(N <= buff_.capacity());
+					if (N > buff_.size()) buff_.resize(N);
+					if constexpr (sizeof(value_type) == 1) {
+						kernels::fill(buff_.data(), static_cast<unsigned char>(val_), N);
+					}
+					else {
+						::std::fill(buff_.data(), buff_.data() + N, val_);
+					}
 				}
 				return buff_;
 			}
+		private:
+			/*
+			all the arena makers end here
+			payload_ == nullptr means: size_ zeroes
+			capacity_ above the size_ is reserved, and zeroed
+			*/
+			static storage_t arena_allocate_(
+				arena & arena_, value_type const * payload_, size_t size_, size_t capacity_
+			) noexcept
+			{
+				static_assert(std::is_same_v<ownership, shared_ownership>,
+					"arena makers are for the shared_ownership only");
+				capacity_ = (std::max)(size_, capacity_);
+				if (capacity_ <= storage_t::sso_length && allocation::padding < 1) {
+					return payload_ ? storage_t(payload_, size_) : storage_t(size_, value_type(0));
+				}
+				// alignment and padding as the allocation policy requires
+				constexpr size_t align_ = (std::max)(alignof(value_type), allocation::alignment);
+				const size_t bytes_ = (capacity_ + 1) * sizeof(value_type);
+				value_type * block_ = static_cast<value_type *>(
+					arena_.allocate(bytes_ + allocation::padding, align_)
+					);
+				assert(block_);
+				std::memset(reinterpret_cast<char *>(block_) + bytes_, 0, allocation::padding);
+				if (payload_)
+					std::memcpy(block_, payload_, size_ * sizeof(value_type));
+				else
+					std::memset(block_, 0, bytes_);
+				block_[size_] = value_type(0);
+
+				// no allocator, the control block is not in the arena
+				return storage_t::adopt(
+					pointer(block_, arena::no_release{}), size_, capacity_
+				);
+			}
+
+			/*
+			all the non arena makers end here
+			payload_ == nullptr means: size_ zeroes
+			capacity_ above the size_ is reserved, and zeroed
+			*/
+			static storage_t allocate_(
+				value_type const * payload_, size_t size_, size_t capacity_ = 0
+			) noexcept
+			{
+				capacity_ = (std::max)(size_, capacity_);
+				// padded payloads are never inside the instance
+				if (capacity_ <= storage_t::sso_length && allocation::padding < 1) {
+					return payload_ ? storage_t(payload_, size_) : storage_t(size_, value_type(0));
+				}
+				return storage_t::adopt(
+					storage_t::inner::template duplicate<allocation>(payload_, size_, capacity_),
+					size_, capacity_
+				);
+			}
 		}; // smart_buf<CHAR>
 
+		/*
+		the alignment template parameter for the buffer family
+		aligned_buf<char, 64>::make("...").data() is 64 bytes aligned
+		*/
+		template<typename CHAR, std::size_t ALIGN>
+		using aligned_buf = smart_buf<CHAR, aligned_allocation<ALIGN>>;
+
 		using buff_type = typename smart_buf<char>::type;
 		using buff_pointer = typename smart_buf<char>::pointer;
 		using buff_ref_type = typename smart_buf<char>::ref_type;
@@ -371,36 +1086,14 @@ namespace dbj {
 			return sp_;
 		}
 
-		// do not try this at home. ever.
+		// vectorized and never optimized away
+		// see dbj_buf_kernels.h
 		extern "C"	inline void	secure_reset(void *s, size_t n) noexcept
 		{
-			volatile char *p = (char *)s;
-			while (n--) *p++ = 0;
+			kernels::secure_zero(s, n);
 		}
 
 
-		/*----------------------------------------------------------------------------
-		binary comparisons
-		*/
-
-		template<typename CHAR, typename BT = smart_buf<CHAR>  >
-		inline bool operator == (
-			const typename BT::ref_type left_, 
-			const typename BT::ref_type right_
-			)
-			noexcept
-		{
-			const size_t left_size = BT::length(left_);
-			const size_t right_size = BT::length(right_);
-
-			if (left_size != right_size)
-				return false;
-
-			return std::equal(
-				left_.get(), left_.get() + left_size,
-				right_.get(), right_.get() + right_size
-			);
-		}
 		/*----------------------------------------------------------------------------
 		streaming
 		
@@ -459,7 +1152,7 @@ namespace {
 			TU(smart_buf<T>::make(std::basic_string_view<T>(specimen)));
 
 			auto buf = smart_buf<T>::make(BUFSIZ);
-			TU(smart_buf<T>::fill(buf, C));
+			TU(smart_buf<T>::fill(buf, C, BUFSIZ));
 
 			auto sec = smart_buf<T>::make(buf);
 			TU( sec == buf);
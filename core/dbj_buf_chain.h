@@ -0,0 +1,250 @@
+#pragma once
+
+#include "../dbj_gpl_license.h"
+#include "dbj_buf.h"
+#include "dbj_buffer.h"
+
+#include <string_view>
+#include <system_error>
+#include <variant>
+#include <vector>
+
+#ifdef _WIN32
+#include "../win/dbj_win_inc.h"
+#else
+#include <cerrno>
+#include <climits>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+/*
+2019-03-24	dbj@dbj.org	created
+
+scatter-gather chain of the dbj text buffers
+
+output is made of fragments: prefix, payload, delimiters, suffix ...
+joining them into one string, just to write it, is a waste.
+chain is a list of segments, each one is a yanb, a slice or a static
+string view. segments keep the ownership of the fragments, no copy is made.
+
+	using namespace std::literals;
+	dbj::buf::chain line_ ;
+	line_.append("Expression: "sv).append( yanb_ ).append( buffer_ ).append("\n"sv) ;
+	auto ec = line_.write( ::GetStdHandle(STD_OUTPUT_HANDLE) ) ;
+
+WIN32 has no writev() for ordinary handles, thus segments are gathered
+into one stack buffer and written with one WriteFile(), segments larger
+than that buffer are written directly. Elsewhere writev() is used.
+*/
+namespace dbj {
+	namespace buf {
+
+		class chain final
+		{
+		public:
+			// iovec look alike
+			struct io_segment final {
+				char const * data{};
+				std::size_t size{};
+			};
+
+		private:
+			/*
+			std::string_view is for the static string views
+			segment views are not cached, sso payloads live
+			inside the segments and move with them
+			*/
+			using segment = std::variant< std::string_view, yanb, yanb_slice >;
+
+			std::vector<segment> segments_{};
+			std::size_t total_size_{};
+
+			static io_segment io_of(segment const & seg_) noexcept
+			{
+				if (auto yanb_ = std::get_if<yanb>(&seg_))
+					return { yanb_->data(), yanb_->size() };
+				if (auto slice_ = std::get_if<yanb_slice>(&seg_))
+					return { slice_->data(), slice_->size() };
+				auto const & view_ = std::get<std::string_view>(seg_);
+				return { view_.data(), view_.size() };
+			}
+
+			template<typename S>
+			chain & push_(S && seg_, std::size_t size_)
+			{
+				if (size_ < 1) return *this;
+				total_size_ += size_;
+				segments_.emplace_back(std::forward<S>(seg_));
+				return *this;
+			}
+
+		public:
+			chain() = default;
+
+			// segments are stored, thus amortized O(1)
+			chain & append(yanb const & yanb_)
+			{
+				assert(yanb_);
+				return push_(yanb_, yanb_.size());
+			}
+
+			chain & append(yanb_slice const & slice_)
+			{
+				return push_(slice_, slice_.size());
+			}
+
+			// buffer payload is shared, not copied
+			chain & append(buffer const & buffer_)
+			{
+				assert(buffer_.valid());
+				return append(buffer_.slice(0, buffer_.size()));
+			}
+
+			/*
+			NOTE! no ownership is taken, thus this is for string literals
+			and other views that outlive the chain
+			to append a literal without a copy, send it as the std::string_view
+			*/
+			chain & append(std::string_view static_view_)
+			{
+				return push_(static_view_, static_view_.size());
+			}
+
+			/*
+			char arrays can not be told apart from the string literals
+			they might be on the stack or changed later, thus they are copied
+			up to the first '\0', short ones are inside the yanb, no heap
+			*/
+			template<size_t N>
+			chain & append(const char(&charr_)[N])
+			{
+				const std::size_t size_ = yanb::inner::length(charr_, N);
+				if (size_ < 1) return *this;
+				return push_(yanb(charr_, size_), size_);
+			}
+
+			std::size_t size() const noexcept { return total_size_; }
+			std::size_t segments_count() const noexcept { return segments_.size(); }
+			bool empty() const noexcept { return total_size_ < 1; }
+
+			void clear() noexcept { segments_.clear(); total_size_ = 0; }
+
+			// the callback receives std::string_view of each segment
+			template<typename F>
+			void for_each(F callback_) const
+			{
+				for (auto const & seg_ : segments_) {
+					const io_segment io_ = io_of(seg_);
+					callback_(std::string_view(io_.data, io_.size));
+				}
+			}
+
+			// the iovec array
+			std::vector<io_segment> io_segments() const
+			{
+				std::vector<io_segment> retval_;
+				retval_.reserve(segments_.size());
+				for (auto const & seg_ : segments_) retval_.push_back(io_of(seg_));
+				return retval_;
+			}
+
+			// when one contiguous text is required after all
+			yanb join() const
+			{
+				yanb retval_(total_size_, char(0));
+				char * walker_ = retval_.data();
+				for (auto const & seg_ : segments_) {
+					const io_segment io_ = io_of(seg_);
+					std::memcpy(walker_, io_.data, io_.size);
+					walker_ += io_.size;
+				}
+				return retval_;
+			}
+
+#ifdef _WIN32
+			// posix BUFSIZ * 8
+			constexpr static std::size_t gather_size = 0x1000;
+
+			/*
+			as ever we do not use exceptions
+			segments are gathered in gather_size chunks
+			each chunk is one WriteFile()
+			*/
+			std::error_code write(HANDLE handle_) const noexcept
+			{
+				if (handle_ == INVALID_HANDLE_VALUE || handle_ == NULL)
+					return std::make_error_code(std::errc::bad_file_descriptor);
+
+				auto write_ = [&](char const * data_, std::size_t size_) -> std::error_code {
+					while (size_ > 0) {
+						DWORD written_{};
+						const DWORD chunk_ = static_cast<DWORD>((std::min)(size_, std::size_t(MAXDWORD)));
+						if (FALSE == ::WriteFile(handle_, data_, chunk_, &written_, NULL))
+							return std::error_code(int(::GetLastError()), std::system_category());
+						data_ += written_;
+						size_ -= written_;
+					}
+					return {};
+				};
+
+				char gather_[gather_size];
+				std::size_t gathered_{};
+
+				for (auto const & seg_ : segments_) {
+					const io_segment io_ = io_of(seg_);
+					if (gathered_ + io_.size > gather_size) {
+						if (auto ec_ = write_(gather_, gathered_); ec_) return ec_;
+						gathered_ = 0;
+					}
+					if (io_.size > gather_size) {
+						if (auto ec_ = write_(io_.data, io_.size); ec_) return ec_;
+						continue;
+					}
+					std::memcpy(gather_ + gathered_, io_.data, io_.size);
+					gathered_ += io_.size;
+				}
+				return write_(gather_, gathered_);
+			}
+#else
+			/*
+			one writev() per IOV_MAX segments
+			partial writes are resumed
+			*/
+			std::error_code write(int fd_) const noexcept
+			{
+				std::vector<::iovec> iov_;
+				iov_.reserve(segments_.size());
+				for (auto const & seg_ : segments_) {
+					const io_segment io_ = io_of(seg_);
+					iov_.push_back({ const_cast<char *>(io_.data), io_.size });
+				}
+
+				std::size_t next_ = 0;
+				while (next_ < iov_.size()) {
+					const int count_ = static_cast<int>(
+						(std::min)(iov_.size() - next_, std::size_t(IOV_MAX))
+						);
+					::ssize_t written_ = ::writev(fd_, iov_.data() + next_, count_);
+					if (written_ < 0) {
+						if (errno == EINTR) continue;
+						return std::error_code(errno, std::system_category());
+					}
+					// skip what was written
+					std::size_t done_ = static_cast<std::size_t>(written_);
+					while (next_ < iov_.size() && done_ >= iov_[next_].iov_len) {
+						done_ -= iov_[next_].iov_len;
+						++next_;
+					}
+					if (done_ > 0) {
+						iov_[next_].iov_base = static_cast<char *>(iov_[next_].iov_base) + done_;
+						iov_[next_].iov_len -= done_;
+					}
+				}
+				return {};
+			}
+#endif // _WIN32
+		}; // chain
+
+	} // buf
+} // dbj
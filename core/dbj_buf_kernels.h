@@ -0,0 +1,314 @@
+#pragma once
+
+#include "../dbj_gpl_license.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/*
+2019-03-26	dbj@dbj.org	created
+
+fill, compare and secure zero kernels for the dbj::buf family
+
+SSE2 and AVX2 versions with the portable scalar fallback.
+the best one is selected once, at runtime, by the CPUID.
+x64 only, 32 bit x86 CPU might not have the SSE2, thus it gets the scalar ones.
+
+	auto const & k_ = dbj::buf::kernels::active() ;
+	k_.fill( p, '*', n ) ;
+	bool same = k_.equal( p, q, n ) ;
+	k_.secure_zero( p, n ) ;
+
+secure_zero is never inlined since it is called through the pointer,
+and its stores are followed by the compiler barrier which uses the
+pointer, thus the compiler can not prove the stores are dead.
+*/
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define DBJ_BUF_KERNELS_X86
+#endif
+
+#ifdef DBJ_BUF_KERNELS_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+// MSVC does not require the target attributes
+#define DBJ_TARGET_AVX2
+#else
+#include <cpuid.h>
+#include <immintrin.h>
+#define DBJ_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif // DBJ_BUF_KERNELS_X86
+
+namespace dbj {
+	namespace buf {
+		namespace kernels {
+
+			using fill_fn = void(*)(void *, unsigned char, std::size_t) noexcept;
+			using equal_fn = bool(*)(void const *, void const *, std::size_t) noexcept;
+			using zero_fn = void(*)(void *, std::size_t) noexcept;
+
+			struct kernel_set final {
+				char const * name{};
+				fill_fn fill{};
+				equal_fn equal{};
+				zero_fn secure_zero{};
+			};
+
+			namespace inner {
+				// stores to p_ are not dead, the compiler must assume
+				// somebody reads them
+				inline void escape(void * p_) noexcept
+				{
+#ifdef _MSC_VER
+					(void)p_;
+					_ReadWriteBarrier();
+#else
+					__asm__ __volatile__("" : : "r"(p_) : "memory");
+#endif
+					std::atomic_signal_fence(std::memory_order_seq_cst);
+				}
+			} // inner
+
+#pragma region scalar
+			namespace scalar {
+
+				inline void fill(void * dst_, unsigned char val_, std::size_t n_) noexcept
+				{
+					std::memset(dst_, val_, n_);
+				}
+
+				inline bool equal(void const * a_, void const * b_, std::size_t n_) noexcept
+				{
+					return 0 == std::memcmp(a_, b_, n_);
+				}
+
+				inline void secure_zero(void * dst_, std::size_t n_) noexcept
+				{
+					volatile unsigned char * p_ = static_cast<unsigned char *>(dst_);
+					while (n_--) *p_++ = 0;
+					inner::escape(dst_);
+				}
+
+				constexpr inline kernel_set set{ "scalar", fill, equal, secure_zero };
+			} // scalar
+#pragma endregion
+
+#ifdef DBJ_BUF_KERNELS_X86
+
+#pragma region sse2
+			namespace sse2 {
+
+				inline void fill(void * dst_, unsigned char val_, std::size_t n_) noexcept
+				{
+					unsigned char * p_ = static_cast<unsigned char *>(dst_);
+					if (n_ < 16) { std::memset(p_, val_, n_); return; }
+					const __m128i v_ = _mm_set1_epi8(static_cast<char>(val_));
+					unsigned char * const last_ = p_ + n_ - 16;
+					// four stores per iteration
+					for (; p_ + 64 <= last_; p_ += 64) {
+						_mm_storeu_si128(reinterpret_cast<__m128i *>(p_), v_);
+						_mm_storeu_si128(reinterpret_cast<__m128i *>(p_ + 16), v_);
+						_mm_storeu_si128(reinterpret_cast<__m128i *>(p_ + 32), v_);
+						_mm_storeu_si128(reinterpret_cast<__m128i *>(p_ + 48), v_);
+					}
+					for (; p_ < last_; p_ += 16)
+						_mm_storeu_si128(reinterpret_cast<__m128i *>(p_), v_);
+					// the tail, overlapping the previous store
+					_mm_storeu_si128(reinterpret_cast<__m128i *>(last_), v_);
+				}
+
+				// bytewise compare of the 16 bytes
+				inline __m128i cmp_(unsigned char const * l_, unsigned char const * r_) noexcept
+				{
+					return _mm_cmpeq_epi8(
+						_mm_loadu_si128(reinterpret_cast<__m128i const *>(l_)),
+						_mm_loadu_si128(reinterpret_cast<__m128i const *>(r_)));
+				}
+
+				inline bool equal(void const * a_, void const * b_, std::size_t n_) noexcept
+				{
+					auto l_ = static_cast<unsigned char const *>(a_);
+					auto r_ = static_cast<unsigned char const *>(b_);
+					if (n_ < 16) return 0 == std::memcmp(l_, r_, n_);
+					std::size_t i_ = 0;
+					// four compares per iteration, one branch
+					for (; i_ + 64 <= n_; i_ += 64) {
+						const __m128i all_ = _mm_and_si128(
+							_mm_and_si128(cmp_(l_ + i_, r_ + i_), cmp_(l_ + i_ + 16, r_ + i_ + 16)),
+							_mm_and_si128(cmp_(l_ + i_ + 32, r_ + i_ + 32), cmp_(l_ + i_ + 48, r_ + i_ + 48)));
+						if (0xFFFF != _mm_movemask_epi8(all_)) return false;
+					}
+					for (; i_ + 16 <= n_; i_ += 16) {
+						const __m128i x_ = _mm_loadu_si128(reinterpret_cast<__m128i const *>(l_ + i_));
+						const __m128i y_ = _mm_loadu_si128(reinterpret_cast<__m128i const *>(r_ + i_));
+						if (0xFFFF != _mm_movemask_epi8(_mm_cmpeq_epi8(x_, y_))) return false;
+					}
+					if (i_ == n_) return true;
+					// the tail, overlapping the previous load
+					i_ = n_ - 16;
+					const __m128i x_ = _mm_loadu_si128(reinterpret_cast<__m128i const *>(l_ + i_));
+					const __m128i y_ = _mm_loadu_si128(reinterpret_cast<__m128i const *>(r_ + i_));
+					return 0xFFFF == _mm_movemask_epi8(_mm_cmpeq_epi8(x_, y_));
+				}
+
+				inline void secure_zero(void * dst_, std::size_t n_) noexcept
+				{
+					if (n_ < 16) { scalar::secure_zero(dst_, n_); return; }
+					fill(dst_, 0, n_);
+					inner::escape(dst_);
+				}
+
+				constexpr inline kernel_set set{ "sse2", fill, equal, secure_zero };
+			} // sse2
+#pragma endregion
+
+#pragma region avx2
+			namespace avx2 {
+
+				DBJ_TARGET_AVX2
+				inline void fill(void * dst_, unsigned char val_, std::size_t n_) noexcept
+				{
+					unsigned char * p_ = static_cast<unsigned char *>(dst_);
+					if (n_ < 32) { sse2::fill(p_, val_, n_); return; }
+					const __m256i v_ = _mm256_set1_epi8(static_cast<char>(val_));
+					unsigned char * const last_ = p_ + n_ - 32;
+					for (; p_ + 128 <= last_; p_ += 128) {
+						_mm256_storeu_si256(reinterpret_cast<__m256i *>(p_), v_);
+						_mm256_storeu_si256(reinterpret_cast<__m256i *>(p_ + 32), v_);
+						_mm256_storeu_si256(reinterpret_cast<__m256i *>(p_ + 64), v_);
+						_mm256_storeu_si256(reinterpret_cast<__m256i *>(p_ + 96), v_);
+					}
+					for (; p_ < last_; p_ += 32)
+						_mm256_storeu_si256(reinterpret_cast<__m256i *>(p_), v_);
+					_mm256_storeu_si256(reinterpret_cast<__m256i *>(last_), v_);
+				}
+
+				DBJ_TARGET_AVX2
+				inline __m256i cmp_(unsigned char const * l_, unsigned char const * r_) noexcept
+				{
+					return _mm256_cmpeq_epi8(
+						_mm256_loadu_si256(reinterpret_cast<__m256i const *>(l_)),
+						_mm256_loadu_si256(reinterpret_cast<__m256i const *>(r_)));
+				}
+
+				DBJ_TARGET_AVX2
+				inline bool equal(void const * a_, void const * b_, std::size_t n_) noexcept
+				{
+					auto l_ = static_cast<unsigned char const *>(a_);
+					auto r_ = static_cast<unsigned char const *>(b_);
+					if (n_ < 32) return sse2::equal(l_, r_, n_);
+					std::size_t i_ = 0;
+					for (; i_ + 128 <= n_; i_ += 128) {
+						const __m256i all_ = _mm256_and_si256(
+							_mm256_and_si256(cmp_(l_ + i_, r_ + i_), cmp_(l_ + i_ + 32, r_ + i_ + 32)),
+							_mm256_and_si256(cmp_(l_ + i_ + 64, r_ + i_ + 64), cmp_(l_ + i_ + 96, r_ + i_ + 96)));
+						if (-1 != _mm256_movemask_epi8(all_)) return false;
+					}
+					for (; i_ + 32 <= n_; i_ += 32) {
+						const __m256i x_ = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(l_ + i_));
+						const __m256i y_ = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(r_ + i_));
+						if (-1 != _mm256_movemask_epi8(_mm256_cmpeq_epi8(x_, y_))) return false;
+					}
+					if (i_ == n_) return true;
+					i_ = n_ - 32;
+					const __m256i x_ = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(l_ + i_));
+					const __m256i y_ = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(r_ + i_));
+					return -1 == _mm256_movemask_epi8(_mm256_cmpeq_epi8(x_, y_));
+				}
+
+				DBJ_TARGET_AVX2
+				inline void secure_zero(void * dst_, std::size_t n_) noexcept
+				{
+					if (n_ < 32) { sse2::secure_zero(dst_, n_); return; }
+					fill(dst_, 0, n_);
+					inner::escape(dst_);
+				}
+
+				constexpr inline kernel_set set{ "avx2", fill, equal, secure_zero };
+			} // avx2
+#pragma endregion
+
+			namespace inner {
+
+				inline void cpuid(int info_[4], int leaf_, int subleaf_ = 0) noexcept
+				{
+#ifdef _MSC_VER
+					__cpuidex(info_, leaf_, subleaf_);
+#else
+					unsigned a_{}, b_{}, c_{}, d_{};
+					__cpuid_count(leaf_, subleaf_, a_, b_, c_, d_);
+					info_[0] = int(a_); info_[1] = int(b_); info_[2] = int(c_); info_[3] = int(d_);
+#endif
+				}
+
+				// AVX2 on the CPU *and* the OS saving the YMM registers
+				inline bool has_avx2() noexcept
+				{
+					int info_[4]{};
+					cpuid(info_, 0);
+					if (info_[0] < 7) return false;
+
+					cpuid(info_, 1);
+					const bool osxsave_ = (info_[2] & (1 << 27)) != 0;
+					const bool avx_ = (info_[2] & (1 << 28)) != 0;
+					if (!(osxsave_ && avx_)) return false;
+
+#ifdef _MSC_VER
+					const unsigned long long xcr0_ = _xgetbv(0);
+#else
+					unsigned eax_{}, edx_{};
+					__asm__ __volatile__("xgetbv" : "=a"(eax_), "=d"(edx_) : "c"(0));
+					const unsigned long long xcr0_ = (static_cast<unsigned long long>(edx_) << 32) | eax_;
+#endif
+					if ((xcr0_ & 0x6) != 0x6) return false;
+
+					cpuid(info_, 7, 0);
+					return (info_[1] & (1 << 5)) != 0;
+				}
+			} // inner
+
+#endif // DBJ_BUF_KERNELS_X86
+
+			// the best kernels for this CPU, selected once
+			inline kernel_set const & active() noexcept
+			{
+				static kernel_set const & selected_ = []() noexcept -> kernel_set const & {
+#ifdef DBJ_BUF_KERNELS_X86
+					if (inner::has_avx2()) return avx2::set;
+					// SSE2 is always there on x64
+					return sse2::set;
+#else
+					return scalar::set;
+#endif
+				}();
+				return selected_;
+			}
+
+			inline void fill(void * dst_, unsigned char val_, std::size_t n_) noexcept
+			{
+				active().fill(dst_, val_, n_);
+			}
+
+			/*
+			short compares are not worth the call through the pointer
+			the CRT memcmp is as fast or faster bellow this size
+			*/
+			constexpr inline std::size_t memcmp_below = 0x100;
+
+			inline bool equal(void const * a_, void const * b_, std::size_t n_) noexcept
+			{
+				if (n_ < memcmp_below) return 0 == std::memcmp(a_, b_, n_);
+				return active().equal(a_, b_, n_);
+			}
+
+			inline void secure_zero(void * dst_, std::size_t n_) noexcept
+			{
+				active().secure_zero(dst_, n_);
+			}
+
+		} // kernels
+	} // buf
+} // dbj
@@ -0,0 +1,365 @@
+#pragma once
+
+#include "../dbj_gpl_license.h"
+#include "dbj_buf.h"
+
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <string_view>
+
+#ifdef _WIN32
+#include "../win/dbj_win_inc.h"
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+/*
+2019-03-30	dbj@dbj.org	created
+
+the large payloads tier, beyond the dbj::buf::max_length
+
+dictionary loads and big reports are megabytes, not kilobytes.
+they are kept in the virtual memory mappings straight from the OS,
+not on the heap. there the mapping can grow in place, without the copy.
+
+	// smart_buf style makers, the tier is selected by the size
+	auto dict_ = dbj::buf::large_buf<char>::make( 0x1000000 ) ;
+	// the builder which grows in place
+	dbj::buf::large_buffer report_ ;
+	report_.append( line_ ).append( line_ ) ... ;
+	auto yanb_ = report_.release() ;
+
+WIN32:	address space is reserved, generously, and pages are committed
+		as the buffer grows, thus growing inside the reservation is in place.
+		large pages require the SeLockMemoryPrivilege and can not be
+		committed gradually, thus they are not used.
+linux:	mmap() / mremap(), mappings of 2MB and more are advised to be
+		transparent huge pages
+else:	mmap(), growing is map, copy and unmap
+*/
+namespace dbj {
+	namespace buf {
+
+		namespace vmem {
+
+			struct mapping final {
+				void * data{};
+				// usable bytes
+				std::size_t size{};
+				// address space taken
+				std::size_t reserved{};
+			};
+
+			// mappings this large are huge pages candidates
+			constexpr inline std::size_t huge_threshold = 0x200000; // 2MB
+
+			inline std::size_t page_size() noexcept
+			{
+				static const std::size_t page_size_ = []() noexcept -> std::size_t {
+#ifdef _WIN32
+					SYSTEM_INFO info_{};
+					::GetSystemInfo(&info_);
+					return info_.dwPageSize;
+#else
+					return static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+#endif
+				}();
+				return page_size_;
+			}
+
+			inline std::size_t round_up(std::size_t bytes_, std::size_t to_) noexcept
+			{
+				return (bytes_ + to_ - 1) / to_ * to_;
+			}
+
+			// zeroed pages, or the empty mapping if the OS said no
+			inline mapping map(std::size_t bytes_) noexcept
+			{
+				const std::size_t size_ = round_up((std::max)(bytes_, std::size_t(1)), page_size());
+#ifdef _WIN32
+				// room to grow in place, 4x or the next 64KB
+				const std::size_t reserved_ = round_up(4 * size_, 0x10000);
+				void * base_ = ::VirtualAlloc(NULL, reserved_, MEM_RESERVE, PAGE_NOACCESS);
+				if (!base_) return {};
+				if (!::VirtualAlloc(base_, size_, MEM_COMMIT, PAGE_READWRITE)) {
+					::VirtualFree(base_, 0, MEM_RELEASE);
+					return {};
+				}
+				return { base_, size_, reserved_ };
+#else
+				void * base_ = ::mmap(nullptr, size_, PROT_READ | PROT_WRITE,
+					MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+				if (base_ == MAP_FAILED) return {};
+#ifdef MADV_HUGEPAGE
+				if (size_ >= huge_threshold) ::madvise(base_, size_, MADV_HUGEPAGE);
+#endif
+				return { base_, size_, size_ };
+#endif
+			}
+
+			inline void unmap(mapping const & map_) noexcept
+			{
+				if (!map_.data) return;
+#ifdef _WIN32
+				::VirtualFree(map_.data, 0, MEM_RELEASE);
+#else
+				::munmap(map_.data, map_.reserved);
+#endif
+			}
+
+			/*
+			content up to used_ bytes is preserved
+			in place if at all possible, the empty mapping if the OS said no
+			map_ is not released in that case
+			*/
+			inline mapping grow(mapping const & map_, std::size_t used_, std::size_t bytes_) noexcept
+			{
+				assert(map_.data);
+				const std::size_t size_ = round_up(bytes_, page_size());
+				if (size_ <= map_.size) return map_;
+#if defined(_WIN32)
+				if (size_ <= map_.reserved) {
+					// commit the next pages of the reservation
+					if (::VirtualAlloc(map_.data, size_, MEM_COMMIT, PAGE_READWRITE))
+						return { map_.data, size_, map_.reserved };
+					return {};
+				}
+#elif defined(__linux__) && defined(MREMAP_MAYMOVE)
+				// in place, or the kernel moves the pages, no copy either way
+				void * moved_ = ::mremap(map_.data, map_.reserved, size_, MREMAP_MAYMOVE);
+				if (moved_ == MAP_FAILED) return {};
+#ifdef MADV_HUGEPAGE
+				if (size_ >= huge_threshold) ::madvise(moved_, size_, MADV_HUGEPAGE);
+#endif
+				return { moved_, size_, size_ };
+#endif
+				// map, copy and unmap
+				mapping fresh_ = map(bytes_);
+				if (!fresh_.data) return {};
+				std::memcpy(fresh_.data, map_.data, used_);
+				unmap(map_);
+				return fresh_;
+			}
+		} // vmem
+
+		/*
+		allocation policy for dbj::buf::smart_buf
+		each block is its own mapping, for the large payloads only
+		*/
+		struct mapped_allocation final
+		{
+			// pages are aligned to much more, this is what is promised
+			constexpr static std::size_t alignment = 0x1000;
+			constexpr static std::size_t padding = 0;
+
+			static void * allocate(std::size_t bytes_) noexcept
+			{
+				return vmem::map(bytes_).data;
+			}
+
+			static void deallocate(void * block_, std::size_t bytes_) noexcept
+			{
+				const std::size_t size_ = vmem::round_up(
+					(std::max)(bytes_, std::size_t(1)), vmem::page_size());
+				// on WIN32 the size does not matter
+				vmem::unmap({ block_, size_, size_ });
+			}
+
+			template<typename C>
+			static std::shared_ptr<C> block(std::size_t count_) noexcept
+			{
+				const std::size_t bytes_ = count_ * sizeof(C);
+				C * block_ = static_cast<C *>(allocate(bytes_));
+				assert(block_);
+				return std::shared_ptr<C>(block_,
+					[bytes_](C * p_) noexcept { deallocate(p_, bytes_); });
+			}
+		};
+
+		/*
+		smart_buf style makers, for any size
+		up to max_length the usual smart_buf<CHAR> is used
+		above it the payload is in its own mapping
+		either way the result is the usual yanb_t<CHAR>
+		*/
+		template<typename CHAR>
+		struct large_buf final
+		{
+			using type = large_buf;
+			using value_type = CHAR;
+			using storage_t = yanb_t<CHAR>;
+
+			// above this the mappings are used
+			constexpr static std::size_t threshold = max_length;
+
+			static bool is_large(std::size_t size_) noexcept { return size_ > threshold; }
+
+			// size_ zeroes, size() of the result is size_
+			static storage_t make(std::size_t size_) noexcept
+			{
+				return make(nullptr, size_);
+			}
+
+			// payload_ == nullptr means size_ zeroes
+			static storage_t make(value_type const * payload_, std::size_t size_) noexcept
+			{
+				assert(size_ > 0);
+				if (!is_large(size_)) {
+					return payload_
+						? smart_buf<CHAR>::make(std::basic_string_view<value_type>(payload_, size_))
+						: storage_t(size_, value_type(0));
+				}
+				return storage_t::adopt(
+					storage_t::inner::template duplicate<mapped_allocation>(payload_, size_),
+					size_, size_
+				);
+			}
+
+			static storage_t make(std::basic_string_view<value_type> sv_) noexcept
+			{
+				return make(sv_.data(), sv_.size());
+			}
+
+			static storage_t & fill(storage_t & buff_, value_type val_, std::size_t N = 0) noexcept
+			{
+				return smart_buf<CHAR>::fill(buff_, val_, N);
+			}
+		};
+
+		/*
+		the builder for the large payloads, it grows in place
+		single owner, zero terminated, as ever no exceptions
+		out of memory is an assert
+		*/
+		template<typename CHAR>
+		class large_buffer_t final
+		{
+		public:
+			using type = large_buffer_t;
+			using value_type = CHAR;
+			using view_type = std::basic_string_view<value_type>;
+
+		private:
+			vmem::mapping map_{};
+			std::size_t size_{};
+
+			// in chars, the terminator excluded
+			std::size_t capacity_of_(vmem::mapping const & m_) const noexcept
+			{
+				return m_.size > 0 ? m_.size / sizeof(value_type) - 1 : 0;
+			}
+
+			void grow_for_(std::size_t extra_) noexcept
+			{
+				const std::size_t needed_ = size_ + extra_;
+				if (needed_ <= capacity()) return;
+				reserve((std::max)(needed_, 2 * capacity()));
+			}
+
+		public:
+			large_buffer_t() noexcept = default;
+
+			explicit large_buffer_t(std::size_t capacity_) noexcept { reserve(capacity_); }
+
+			~large_buffer_t() { vmem::unmap(map_); }
+
+			large_buffer_t(large_buffer_t const &) = delete;
+			large_buffer_t & operator = (large_buffer_t const &) = delete;
+
+			large_buffer_t(large_buffer_t && other_) noexcept { this->swap(other_); }
+
+			large_buffer_t & operator = (large_buffer_t && other_) noexcept
+			{
+				if (&other_ != this) {
+					large_buffer_t temp_(std::move(other_));
+					this->swap(temp_);
+				}
+				return *this;
+			}
+
+			void swap(large_buffer_t & other_) noexcept
+			{
+				std::swap(map_, other_.map_);
+				std::swap(size_, other_.size_);
+			}
+
+			value_type * data() noexcept { return static_cast<value_type *>(map_.data); }
+			value_type const * data() const noexcept { return static_cast<value_type const *>(map_.data); }
+
+			std::size_t size() const noexcept { return size_; }
+			std::size_t capacity() const noexcept { return capacity_of_(map_); }
+			bool empty() const noexcept { return size_ < 1; }
+
+			view_type view() const noexcept { return { data(), size_ }; }
+
+			type & reserve(std::size_t count_) noexcept
+			{
+				if (map_.data && count_ <= capacity()) return *this;
+				const std::size_t bytes_ = (count_ + 1) * sizeof(value_type);
+				vmem::mapping fresh_ = map_.data
+					? vmem::grow(map_, (size_ + 1) * sizeof(value_type), bytes_)
+					: vmem::map(bytes_);
+				assert(fresh_.data);
+				map_ = fresh_;
+				return *this;
+			}
+
+			type & append(view_type sv_) noexcept
+			{
+				if (sv_.empty()) return *this;
+				// sv_ might be looking into this buffer
+				const bool inside_ = map_.data &&
+					(sv_.data() >= data()) && (sv_.data() < data() + size_);
+				const std::size_t offset_ = inside_ ? std::size_t(sv_.data() - data()) : 0;
+				grow_for_(sv_.size());
+				std::memcpy(data() + size_, inside_ ? data() + offset_ : sv_.data(),
+					sv_.size() * sizeof(value_type));
+				size_ += sv_.size();
+				data()[size_] = value_type(0);
+				return *this;
+			}
+
+			type & append(value_type val_, std::size_t count_ = 1) noexcept
+			{
+				if (count_ < 1) return *this;
+				grow_for_(count_);
+				std::fill(data() + size_, data() + size_ + count_, val_);
+				size_ += count_;
+				data()[size_] = value_type(0);
+				return *this;
+			}
+
+			// size becomes 0, the mapping is kept
+			type & clear() noexcept
+			{
+				size_ = 0;
+				if (map_.data) data()[0] = value_type(0);
+				return *this;
+			}
+
+			/*
+			hand over the mapping to the yanb_t, no copy is made
+			the mapping is released when the last yanb_t is gone
+			this builder is left empty
+			*/
+			yanb_t<value_type> release() noexcept
+			{
+				if (!map_.data) return {};
+				vmem::mapping map_copy_ = map_;
+				std::shared_ptr<value_type> block_(data(),
+					[map_copy_](value_type *) noexcept { vmem::unmap(map_copy_); });
+				auto retval_ = yanb_t<value_type>::adopt(std::move(block_), size_, capacity());
+				map_ = {};
+				size_ = 0;
+				return retval_;
+			}
+		};
+
+		using large_buffer = large_buffer_t<char>;
+		using large_wbuffer = large_buffer_t<wchar_t>;
+
+	} // buf
+} // dbj
@@ -14,6 +14,7 @@
 #include <cstdint>
 #include <cstddef>
 #include <cstring>
+#include <utility>
 #include <vector>
 
 namespace dbj {
@@ -37,8 +38,8 @@ namespace dbj {
 		struct buffer final 
 {
 			using smart_buf = typename ::dbj::buf::smart_buf<char>;
-			// yanb_t<CHAR>; aka
-			using storage_t = typename yanb_t<CHAR>::type;
+			// yanb_t<char>; aka
+			using storage_t = typename yanb_t<char>::type;
 			using type = buffer;
 			using reference_type = type & ;
 			// this is the std::share_ptr<char>
@@ -50,6 +51,59 @@ namespace dbj {
 		private:
 			// the data is here
 			storage_t data_{}; // size == 0
+			// a writing pointer or iterator was handed out
+			// thus the payload can not be shared any more
+			bool unshareable_{};
+
+			// view has to follow the data_
+			void sync_view_() noexcept {
+				if (this->data_)
+					this->view = { data_.data(), data_.size() };
+				else
+					this->view = {};
+			}
+
+			// geometric growth, so that appending is amortized O(1)
+			void grow_for_(size_t extra_)
+			{
+				const size_t needed_ = data_.size() + extra_;
+				if (needed_ <= data_.capacity() && data_.unique())
+					return;
+				data_.reserve((std::max)(needed_, 2 * data_.capacity()));
+			}
+
+			// copy on write, the payload shared with other buffers
+			// or slices is cloned, before the first write
+			void detach_()
+			{
+				if (this->valid() && !data_.unique()) {
+					data_.reserve(data_.capacity());
+					sync_view_();
+				}
+			}
+
+			// the writing pointer is about to be handed out
+			value_type * leak_()
+			{
+				detach_();
+				unshareable_ = true;
+				return data_.data();
+			}
+
+			// new payload, the old pointers are not pointing into it
+			void set_payload_(storage_t && payload_) noexcept
+			{
+				this->data_ = std::move(payload_);
+				this->unshareable_ = false;
+				sync_view_();
+			}
+
+			// unshareable payload is copied, not shared
+			storage_t share_() const noexcept
+			{
+				if (!unshareable_) return data_;
+				return valid() ? storage_t(data_.data(), data_.size()) : storage_t{};
+			}
 		public:
 			// for an instant and  full set of services we maintain 
 			// the string_view instance
@@ -60,12 +114,28 @@ namespace dbj {
 
 			// allocated but empty yields true
 			bool empty() const noexcept  {
-				return (valid() && this->data_[0] != '\0');
+				return (!valid() || view.size() < 1);
 			}
 
-			iterator data() noexcept { return data_.data();	}
+			/*
+			2019-03-28	dbj@dbj.org	copy on write
+
+			copies are O(1), they share the payload
+			non const data(), begin(), end(), front(), back() and fill()
+			are writing, thus on the shared payload they first make
+			this buffer its own copy. for reading use the const overloads.
+
+			the pointers and iterators handed out by the writing methods
+			can be used to write later, thus after them the payload of 
+			this buffer is never shared again, copies and slices of it 
+			are deep copies, until this buffer gets a new payload
+			*/
+			iterator data() { return leak_(); }
 			citerator data() const noexcept { return data_.data();	}
 
+			// true if no copy will be made on the next write
+			bool unique() const noexcept { return data_.unique(); }
+
 			size_t const size() const noexcept { return this->view.size();	}
 			size_t size() noexcept { return view.size(); }
 
@@ -73,10 +143,11 @@ namespace dbj {
 			buffer() = default;
 
 			// sized but empty buffer
+			// size() is 0, new_size chars can be appended without reallocation
 			explicit buffer(inside_1_and_max new_size) noexcept
 			{
-				data_.reset( ::dbj::buf::smart_buf<char>::make( new_size) );
-				view = data_.data(); // dangerous?
+				data_ = smart_buf::make( new_size );
+				sync_view_();
 			}
 
 			// copy
@@ -94,15 +165,20 @@ namespace dbj {
 			}
 			// NOTE! it was found manualy implemented
 			// move as in here, speeds up the moving by min 200%
+			// views are not swapped, short payloads are inside the data_
 			buffer(buffer && another_) noexcept {
-				std::swap( this->data_ , another_.data_);
-				std::swap( this->view  , another_.view );
+				this->data_.swap(another_.data_);
+				std::swap(this->unshareable_, another_.unshareable_);
+				this->sync_view_();
+				another_.sync_view_();
 			}
 
 			buffer & operator = ( buffer && another_) noexcept {
 				if (&another_ != this) {
-					std::swap(this->data_, another_.data_);
-					std::swap(this->view, another_.view);
+					this->data_.swap(another_.data_);
+					std::swap(this->unshareable_, another_.unshareable_);
+					this->sync_view_();
+					another_.sync_view_();
 				}
 				return *this;
 			}
@@ -114,30 +190,113 @@ namespace dbj {
 			>
 				buffer(const T(&charr)[N]) noexcept
 			{
-				assign(charr, charr + N);
+				assign(charr, charr + storage_t::inner::length(charr, N));
 			}
 
+			// O(1), the payload is shared until the first write
 			void assign(const buffer & another_) noexcept
 			{
-				this->data_ = another_.data_;
-				this->view  = another_.view;
+				set_payload_(another_.share_());
 			}
 
 			void assign(char const * from_, char const * to_) noexcept
 			{
 				assert(from_ && to_);
-				std::string sv_(from_, to_); // normalize ?
-				this->data_.reset(sv_.c_str()); // take ownership?
-				this->view = this->data_.data();
+				set_payload_(storage_t(from_, size_t(std::distance(from_, to_))));
 			}
 
 			void assign(char const * from_ ) noexcept
 			{
 				assert(from_ );
-				this->data_.reset( from_ );
-				this->view = this->data_.data();
+				set_payload_(storage_t(from_));
 			}
 
+#pragma region builder
+			/*
+			2019-03-14	dbj@dbj.org
+
+			building the content piece by piece
+			capacity grows geometrically, thus building the buffer 
+			of any size requires O(log n) allocations, not O(n)
+			*/
+			size_t capacity() const noexcept { return data_.capacity(); }
+
+			buffer & reserve(size_t new_capacity_)
+			{
+				data_.reserve(new_capacity_);
+				sync_view_();
+				return *this;
+			}
+
+			buffer & append(std::string_view sv_)
+			{
+				if (sv_.empty()) return *this;
+				const size_t old_size_ = data_.size();
+				// sv_ might be looking into this buffer
+				// which might be moved by the growth
+				const bool inside_ = valid() && 
+					(sv_.data() >= data_.data()) &&
+					(sv_.data() < data_.data() + old_size_);
+				const size_t offset_ = inside_ ? size_t(sv_.data() - data_.data()) : 0;
+				grow_for_(sv_.size());
+				std::memcpy(data_.data() + old_size_, 
+					(inside_ ? data_.data() + offset_ : sv_.data()), sv_.size());
+				data_.resize(old_size_ + sv_.size());
+				sync_view_();
+				return *this;
+			}
+
+			buffer & append(char val_, size_t count_ = 1)
+			{
+				if (count_ < 1) return *this;
+				const size_t old_size_ = data_.size();
+				grow_for_(count_);
+				std::memset(data_.data() + old_size_, val_, count_);
+				data_.resize(old_size_ + count_);
+				sync_view_();
+				return *this;
+			}
+
+			// size becomes 0, capacity is kept
+			buffer & clear() noexcept
+			{
+				if (valid() && data_.unique()) {
+					data_.resize(0);
+				}
+				else {
+					set_payload_(storage_t{});
+					return *this;
+				}
+				sync_view_();
+				return *this;
+			}
+
+			/*
+			zero copy window into this buffer
+			the slice keeps the payload alive
+			once sliced, appending to this buffer makes a new payload
+			thus slices never see the change
+			*/
+			yanb_slice slice(size_t offset_, size_t count_) const noexcept
+			{
+				assert(valid());
+				return { share_(), offset_, count_ };
+			}
+
+			/*
+			hand over the storage, no copy is made
+			this buffer is left in the default, invalid state
+			*/
+			storage_t release() noexcept
+			{
+				storage_t retval_{};
+				retval_.swap(this->data_);
+				this->unshareable_ = false;
+				sync_view_();
+				return retval_;
+			}
+#pragma endregion builder
+
 			// notice the usage of the dbj::insider definition
 			// as  argument type
 			char const & operator [] (inside_1_and_max idx_) const
@@ -152,20 +311,21 @@ namespace dbj {
 				return std::addressof(p);
 			}
 
-			iterator  begin() noexcept { return data_.data(); }
-			iterator  end()   noexcept { return data_.data() + view.size(); }
+			iterator  begin() { return leak_(); }
+			iterator  end()   { return leak_() + view.size(); }
 			citerator begin() const noexcept { return data_.data(); }
 			citerator end()   const noexcept { return data_.data() + view.size(); }
 
-			value_type & front() noexcept { assert(valid()); return data_[0]; }
-			value_type & back()  noexcept { assert(valid()); return data_[view.size() - 1]; }
+			value_type & front() { assert(valid()); return leak_()[0]; }
+			value_type & back()  { assert(valid()); return leak_()[view.size() - 1]; }
 
-			buffer const & fill(char val_) noexcept
+			buffer const & fill(char val_)
 			{
 				// I do allow for default ctor which leaves the instance 
 				// in the invalid state, but I do not allow to use it
 				// this all complicates the usage
 				assert( this->valid());
+				detach_();
 				// always send the size_
 				// data_[0] == '\0' is the state of 
 				// alocated but empty buffer
@@ -184,12 +344,13 @@ namespace dbj {
 
 			//  buffer friends live here
 
+			// const data() is used, thus the payload is not cloned
 			friend std::string to_string(const reference_type from_) noexcept {
-				return { from_.data() };
+				return { std::as_const(from_).data() };
 			}
 
 			friend std::vector<char> to_vector(const reference_type from_) noexcept {
-				std::string str_(from_.data());
+				std::string str_(std::as_const(from_).data());
 				return { str_.begin(), str_.end() };
 			}
 
@@ -222,10 +383,8 @@ namespace dbj {
 				if (left_.size() != right_.size())
 					return false;
 
-				return std::equal(
-					left_.begin(), left_.end(),
-					right_.begin(), right_.end()
-				);
+				return kernels::equal(
+					std::as_const(left_).data(), std::as_const(right_).data(), left_.size());
 			}
 #ifdef DBJ_BUFFERS_IOSTREAMS
 			friend std::ostream & operator << (std::ostream & os, buffer const & cb_)
@@ -0,0 +1,223 @@
+#pragma once
+
+#include "../dbj_gpl_license.h"
+#include "dbj_buf_kernels.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+
+// std::span views are there if std::span is
+#if __has_include(<version>)
+#include <version>
+#endif
+#ifdef __cpp_lib_span
+#include <span>
+#endif
+
+/*
+2019-03-22	dbj@dbj.org	created
+
+binary safe buffer, for I/O and serialization
+
+everything else in dbj::buf is about zero terminated text
+dbj::buf::bytes is not. it has explicit size and capacity,
+its elements are std::byte, embedded zeroes are just data.
+there is no strlen() in here.
+
+single owner, moving is swapping of three members.
+copy is a deep copy, it is not cheap and it is not meant to be.
+as ever, no exceptions, out of memory is an assert.
+*/
+namespace dbj {
+	namespace buf {
+
+		class bytes final
+		{
+		public:
+			using type = bytes;
+			using value_type = std::byte;
+			using iterator = value_type * ;
+			using citerator = value_type const * ;
+
+		private:
+			value_type * data_{};
+			std::size_t size_{};
+			std::size_t capacity_{};
+
+			// unique ownership, thus realloc() can grow in place
+			void reallocate_(std::size_t new_capacity_) noexcept
+			{
+				assert(new_capacity_ >= size_);
+				if (new_capacity_ == capacity_) return;
+				void * fresh_ = std::realloc(data_, new_capacity_ > 0 ? new_capacity_ : 1);
+				assert(fresh_);
+				data_ = static_cast<value_type *>(fresh_);
+				capacity_ = new_capacity_;
+			}
+
+			void grow_for_(std::size_t extra_) noexcept
+			{
+				const std::size_t needed_ = size_ + extra_;
+				if (needed_ <= capacity_) return;
+				reallocate_((std::max)(needed_, 2 * capacity_));
+			}
+
+		public:
+			bytes() noexcept = default;
+
+			// count_ zero bytes
+			explicit bytes(std::size_t count_) noexcept
+			{
+				reallocate_(count_);
+				if (count_ > 0) std::memset(data_, 0, count_);
+				size_ = count_;
+			}
+
+			bytes(void const * from_, std::size_t count_) noexcept
+			{
+				append(from_, count_);
+			}
+
+			~bytes() { std::free(data_); }
+
+			bytes(bytes const & other_) noexcept
+				: bytes(other_.data_, other_.size_)
+			{}
+
+			bytes & operator = (bytes const & other_) noexcept
+			{
+				if (&other_ != this) {
+					bytes temp_(other_);
+					this->swap(temp_);
+				}
+				return *this;
+			}
+
+			bytes(bytes && other_) noexcept { this->swap(other_); }
+
+			bytes & operator = (bytes && other_) noexcept
+			{
+				if (&other_ != this) {
+					bytes temp_(std::move(other_));
+					this->swap(temp_);
+				}
+				return *this;
+			}
+
+			void swap(bytes & other_) noexcept
+			{
+				std::swap(data_, other_.data_);
+				std::swap(size_, other_.size_);
+				std::swap(capacity_, other_.capacity_);
+			}
+
+			value_type * data() noexcept { return data_; }
+			value_type const * data() const noexcept { return data_; }
+
+			std::size_t size() const noexcept { return size_; }
+			std::size_t capacity() const noexcept { return capacity_; }
+			bool empty() const noexcept { return size_ < 1; }
+
+			iterator  begin() noexcept { return data_; }
+			iterator  end()   noexcept { return data_ + size_; }
+			citerator begin() const noexcept { return data_; }
+			citerator end()   const noexcept { return data_ + size_; }
+
+			value_type & operator [] (std::size_t idx_) noexcept {
+				assert(idx_ < size_); return data_[idx_];
+			}
+			value_type const & operator [] (std::size_t idx_) const noexcept {
+				assert(idx_ < size_); return data_[idx_];
+			}
+
+			bytes & reserve(std::size_t new_capacity_) noexcept
+			{
+				if (new_capacity_ > capacity_) reallocate_(new_capacity_);
+				return *this;
+			}
+
+			// new bytes, if any, are zeroes
+			bytes & resize(std::size_t count_) noexcept
+			{
+				if (count_ > size_) {
+					grow_for_(count_ - size_);
+					std::memset(data_ + size_, 0, count_ - size_);
+				}
+				size_ = count_;
+				return *this;
+			}
+
+			bytes & append(void const * from_, std::size_t count_) noexcept
+			{
+				if (count_ < 1) return *this;
+				assert(from_);
+				// from_ might be inside this instance
+				const value_type * src_ = static_cast<value_type const *>(from_);
+				const bool inside_ = data_ && (src_ >= data_) && (src_ < data_ + size_);
+				const std::size_t offset_ = inside_ ? std::size_t(src_ - data_) : 0;
+				grow_for_(count_);
+				std::memcpy(data_ + size_, inside_ ? data_ + offset_ : src_, count_);
+				size_ += count_;
+				return *this;
+			}
+
+			bytes & append(bytes const & other_) noexcept
+			{
+				return append(other_.data_, other_.size_);
+			}
+
+			bytes & append(std::byte val_, std::size_t count_ = 1) noexcept
+			{
+				if (count_ < 1) return *this;
+				grow_for_(count_);
+				std::memset(data_ + size_, std::to_integer<int>(val_), count_);
+				size_ += count_;
+				return *this;
+			}
+
+			// capacity is kept
+			bytes & clear() noexcept { size_ = 0; return *this; }
+
+			// give back what is not used
+			bytes & shrink_to_fit() noexcept
+			{
+				reallocate_(size_);
+				return *this;
+			}
+
+#ifdef __cpp_lib_span
+			std::span<value_type> span() noexcept { return { data_, size_ }; }
+			std::span<value_type const> span() const noexcept { return { data_, size_ }; }
+
+			// window into the bytes, no copy
+			std::span<value_type const> subspan(std::size_t offset_, std::size_t count_) const noexcept
+			{
+				assert(offset_ <= size_);
+				return span().subspan(offset_, (std::min)(count_, size_ - offset_));
+			}
+#endif // __cpp_lib_span
+
+			friend bool operator == (bytes const & left_, bytes const & right_) noexcept
+			{
+				if (left_.size_ != right_.size_) return false;
+				if (left_.size_ < 1) return true;
+				return kernels::equal(left_.data_, right_.data_, left_.size_);
+			}
+
+			friend bool operator != (bytes const & left_, bytes const & right_) noexcept
+			{
+				return !(left_ == right_);
+			}
+
+			friend void swap(bytes & left_, bytes & right_) noexcept
+			{
+				left_.swap(right_);
+			}
+		}; // bytes
+
+	} // buf
+} // dbj
@@ -2,6 +2,25 @@
 
 #include "dbj_buffer.h"
 
+#include <charconv>
+#include <cstdio>
+#include <cstdlib>
+#include <cwchar>
+#include <limits>
+#include <string_view>
+#include <type_traits>
+
+#if __has_include(<version>)
+#include <version>
+#endif
+
+#ifdef _WIN32
+#include "../win/dbj_win_inc.h"
+#else
+#include <cerrno>
+#include <unistd.h>
+#endif
+
 namespace dbj {
 	namespace fmt {
 
@@ -43,17 +62,21 @@ namespace dbj {
 			return value.get() ;
 		}
 
-		inline char const * frm_arg( ::dbj::buf::buffer::type value) noexcept
+		/*
+		by reference, data() of the short payloads is inside the instance
+		and the buffer copy would be a copy on write clone
+		*/
+		inline char const * frm_arg( ::dbj::buf::buffer::type const & value) noexcept
 		{
 			return value.data() ;
 		}
 
-		inline char const * frm_arg( ::dbj::buf::yanb::type value ) noexcept
+		inline char const * frm_arg( ::dbj::buf::yanb::type const & value ) noexcept
 		{
 			return value.data() ;
 		}
 
-		inline wchar_t const * frm_arg( ::dbj::buf::yanwb::type value) noexcept
+		inline wchar_t const * frm_arg( ::dbj::buf::yanwb::type const & value) noexcept
 		{
 			return value.data() ;
 		}
@@ -86,7 +109,17 @@ namespace dbj {
 		/*
 		vaguely inspired by
 		https://stackoverflow.com/a/39972671/10870835
+
+		2019-03-31	dbj@dbj.org	single pass, stack first
+
+		formatting is done once, into the stack buffer
+		results up to yanb_sso_length are not on the heap at all
+		the rest are copied once, into the one heap block
+		only if the stack buffer is not enough, the output is formatted 
+		again into one exactly sized heap block, which is adopted, not copied
 		*/
+		constexpr inline std::size_t to_buff_stack_size = 512;
+
 		template<typename ... Args>
 		inline dbj::buf::yanb
 			to_buff(std::string_view format_, Args /*const &*/ ...args)
@@ -94,16 +127,20 @@ namespace dbj {
 		{
 			static_assert(sizeof...(args) < 255, "\n\nmax 255 arguments allowed\n");
 			const auto fmt = format_.data();
-			// 1: what is the size required
-			size_t size = 1 + std::snprintf(nullptr, 0, fmt, frm_arg( args ) ...);
-			assert(size > 0);
-			// 2: use it at runtime
-			auto buf = std::make_unique<char[]>(size + 1);
+			char stack_[to_buff_stack_size];
 			// each arg becomes arg to the frm_arg() overload found
-			size = std::snprintf(buf.get(), size, fmt, frm_arg( args ) ...);
-			assert(size > 0);
+			const int rezult_ = std::snprintf(stack_, to_buff_stack_size, fmt, frm_arg(args) ...);
+			assert(rezult_ > -1);
+			if (rezult_ < 0) return {};
+
+			const size_t size_ = size_t(rezult_);
+			if (size_ < to_buff_stack_size)
+				return { stack_, size_ };
 
-			return {buf.get()};
+			// snprintf has told us the exact size required
+			auto block_ = dbj::buf::default_allocation::template block<char>(size_ + 1);
+			std::snprintf(block_.get(), size_ + 1, fmt, frm_arg(args) ...);
+			return dbj::buf::yanb::adopt(std::move(block_), size_, size_);
 		}
 		// wide version
 		template<typename ... Args>
@@ -113,16 +150,150 @@ namespace dbj {
 		{
 			static_assert(sizeof...(args) < 255, "\n\nmax 255 arguments allowed\n");
 			const auto fmt = format_.data();
-			// 1: what is the size required
-			size_t size = 1 + std::swprintf(nullptr, 0, fmt, frm_arg(args) ...);
-			assert(size > 0);
-			// 2: use it at runtime
-			auto buf = std::make_unique<wchar_t[]>(size + 1);
-			// each arg becomes arg to the frm_arg() overload found
-			size = std::swprintf(buf.get(), size, fmt, frm_arg(args) ...);
-			assert(size > 0);
+			wchar_t stack_[to_buff_stack_size];
+			int rezult_ = std::swprintf(stack_, to_buff_stack_size, fmt, frm_arg(args) ...);
+			if (rezult_ > -1)
+				return { stack_, size_t(rezult_) };
 
-			return { buf.get() };
+			/*
+			swprintf does not tell the size required on overflow
+			MSVC swprintf measures, if given no buffer
+			elsewhere the capacity is doubled until the output fits
+			*/
+#ifdef _MSC_VER
+			const int measured_ = std::swprintf(nullptr, 0, fmt, frm_arg(args) ...);
+			assert(measured_ > -1);
+			if (measured_ < 0) return {};
+			size_t capacity_ = size_t(measured_);
+#else
+			size_t capacity_ = 2 * to_buff_stack_size;
+#endif
+			for (;;) {
+				auto block_ = dbj::buf::default_allocation::template block<wchar_t>(capacity_ + 1);
+				rezult_ = std::swprintf(block_.get(), capacity_ + 1, fmt, frm_arg(args) ...);
+				if (rezult_ > -1)
+					return dbj::buf::yanwb::adopt(std::move(block_), size_t(rezult_), capacity_);
+				// encoding error, not the overflow
+				assert(capacity_ < dbj::buf::max_length * to_buff_stack_size);
+				if (capacity_ >= dbj::buf::max_length * to_buff_stack_size) return {};
+				capacity_ *= 2;
+			}
+		}
+
+/*
+2019-04-05	dbj@dbj.org	floating point backend
+
+printf("%f") is slow, and 6 decimals lose the precision
+std::to_chars gives the shortest text which reads back into the
+same value, or the fixed notation with the required precision
+
+	auto f_ = dbj::fmt::float_to_chars( 0.1 ) ;			// "0.1"
+	auto g_ = dbj::fmt::float_to_chars( 3.14159, 2 ) ;	// "3.14"
+	use( f_.view() ) ;
+
+without the floating point std::to_chars, snprintf("%g") with the
+least precision which reads back into the same value is used
+*/
+		struct float_chars final {
+			// fixed notation of DBL_MAX has 309 digits
+			// above this size the scientific notation is used
+			char data[0x200]{};
+			std::size_t size{};
+
+			std::string_view view() const noexcept { return { data, size }; }
+		};
+
+		// precision_ < 0 is the shortest round trip, else the fixed notation
+		template<typename T>
+		inline float_chars float_to_chars(T value_, int precision_ = -1) noexcept
+		{
+			static_assert(std::is_floating_point_v<T>,
+				"dbj::fmt::float_to_chars requires a floating point argument");
+			float_chars rez_{};
+			char * const first_ = rez_.data;
+			// one left for the terminator
+			char * const last_ = rez_.data + sizeof(rez_.data) - 1;
+#if defined(__cpp_lib_to_chars) && (__cpp_lib_to_chars >= 201611L)
+			std::to_chars_result tc_ = (precision_ < 0)
+				? std::to_chars(first_, last_, value_)
+				: std::to_chars(first_, last_, value_, std::chars_format::fixed, precision_);
+			if (tc_.ec != std::errc{})
+				// too long for the fixed notation
+				tc_ = (precision_ < 0)
+				? std::to_chars(first_, last_, value_, std::chars_format::scientific)
+				: std::to_chars(first_, last_, value_, std::chars_format::scientific, precision_);
+			rez_.size = (tc_.ec == std::errc{}) ? std::size_t(tc_.ptr - first_) : 0;
+#else
+			using limits_ = std::numeric_limits<T>;
+			const std::size_t room_ = std::size_t(last_ - first_) + 1;
+			const auto long_value_ = static_cast<long double>(value_);
+			int written_ = -1;
+			if (precision_ < 0) {
+				for (int digits_ = limits_::digits10; digits_ <= limits_::max_digits10; ++digits_) {
+					written_ = std::snprintf(first_, room_, "%.*Lg", digits_, long_value_);
+					if (written_ < 0 || std::size_t(written_) >= room_) break;
+					// read back as T, not rounded twice through the long double
+					T back_{};
+					if constexpr (std::is_same_v<T, float>) back_ = std::strtof(first_, nullptr);
+					else if constexpr (std::is_same_v<T, double>) back_ = std::strtod(first_, nullptr);
+					else back_ = std::strtold(first_, nullptr);
+					if (back_ == value_) break;
+				}
+			}
+			else {
+				written_ = std::snprintf(first_, room_, "%.*Lf", precision_, long_value_);
+				if (written_ < 0 || std::size_t(written_) >= room_)
+					written_ = std::snprintf(first_, room_, "%.*Le", precision_, long_value_);
+			}
+			rez_.size = (written_ < 0) ? 0 : (std::min)(std::size_t(written_), room_ - 1);
+#endif
+			rez_.data[rez_.size] = '\0';
+			return rez_;
+		}
+
+/*
+2019-04-04	dbj@dbj.org	narrow output, no wide round trip
+
+the formatted bytes are given to stdout as they are
+WIN32:	with the UTF-8 console code page, or stdout redirected to a file
+		or pipe, the bytes go straight to WriteFile(), otherwise the
+		legacy console gets them through wprintf(L"%S"), as before
+else:	stdout is UTF-8, the bytes go straight to write(1)
+
+whatever is still in the CRT stdout buffer is flushed first,
+thus the order of the output is kept
+*/
+		inline void write_stdout(char const * data_, std::size_t size_) noexcept
+		{
+			if (!data_ || size_ < 1) return;
+#ifdef _WIN32
+			HANDLE out_ = ::GetStdHandle(STD_OUTPUT_HANDLE);
+			const bool direct_ = (out_ != NULL) && (out_ != INVALID_HANDLE_VALUE) &&
+				((::GetFileType(out_) != FILE_TYPE_CHAR) || (::GetConsoleOutputCP() == CP_UTF8));
+			if (!direct_) {
+				// the legacy console, the CRT transforms
+				// data_ is not always zero terminated
+				std::wprintf(L"%.*S", int(size_), data_);
+				return;
+			}
+			std::fflush(stdout);
+			while (size_ > 0) {
+				DWORD written_{};
+				const DWORD chunk_ = DWORD((std::min)(size_, std::size_t(0x40000000)));
+				if (!::WriteFile(out_, data_, chunk_, &written_, NULL)) return;
+				data_ += written_; size_ -= written_;
+			}
+#else
+			std::fflush(stdout);
+			while (size_ > 0) {
+				const ::ssize_t written_ = ::write(STDOUT_FILENO, data_, size_);
+				if (written_ < 0) {
+					if (errno == EINTR) continue;
+					return;
+				}
+				data_ += written_; size_ -= std::size_t(written_);
+			}
+#endif
 		}
 
 /*
@@ -135,7 +306,20 @@ crash will be spectacular
 		print(std::string_view format_, Args /*const &*/ ... args)
 		noexcept
 	{
-		std::wprintf(L"%S", fmt::to_buff(format_, args...).data());
+		// formatted on the stack, printed from there
+		// if the stack is not enough, snprintf has told the size
+		// and the output is formatted once more, into one block
+		char stack_[to_buff_stack_size];
+		const int rezult_ = std::snprintf(stack_, to_buff_stack_size, format_.data(), frm_arg(args) ...);
+		if (rezult_ < 0) return;
+		const size_t size_ = size_t(rezult_);
+		if (size_ < to_buff_stack_size) {
+			write_stdout(stack_, size_);
+			return;
+		}
+		auto block_ = dbj::buf::default_allocation::template block<char>(size_ + 1);
+		std::snprintf(block_.get(), size_ + 1, format_.data(), frm_arg(args) ...);
+		write_stdout(block_.get(), size_);
 	}
 
 	} // fmt
@@ -162,17 +346,26 @@ namespace dbj {
 		}
 #endif
 		// DBJ::TRACE exist in release builds too
+		// not on WIN32 there is no debugger output, stderr is used
 		template <typename ... Args>
 		inline void trace(wchar_t const * const message, Args ... args) noexcept
 		{
 			auto buf_ = dbj::fmt::to_buff(message, args...);
+#ifdef _WIN32
 			::OutputDebugStringW(buf_.data()	);
+#else
+			std::fprintf(stderr, "%ls", buf_.data());
+#endif
 		}
 		template <typename ... Args>
 		inline void trace(const char * const message, Args ... args) noexcept
 		{
 			auto buf_ = dbj::fmt::to_buff(message, args...);
+#ifdef _WIN32
 			::OutputDebugStringA(buf_.data()	);
+#else
+			std::fwrite(buf_.data(), 1, buf_.size(), stderr);
+#endif
 		}
 
 #pragma warning( push )
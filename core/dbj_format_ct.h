@@ -0,0 +1,612 @@
+#pragma once
+
+#include "../dbj_gpl_license.h"
+#include "dbj_format.h"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <cwchar>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#if __has_include(<version>)
+#include <version>
+#endif
+
+/*
+2019-04-02	dbj@dbj.org	created
+
+type safe formatting, the format string is parsed at compile time
+
+	// C++17
+	auto y1 = dbj::fmt::format( DBJ_FMT("{} + {} = {}"), 1, 1, 2 ) ;
+	// C++20
+	auto y2 = dbj::fmt::format<"{:x} is {:.2}">( 255, 3.14159 ) ;
+
+placeholders
+	{}		any supported argument
+	{:x}	integer in hex
+	{:.N}	floating point, N digits after the decimal point
+	{{ }}	the braces themselves
+
+the result is dbj::buf::yanb, made as fmt::to_buff() makes it: on the
+stack first, on the heap only if the stack is not enough
+
+everything is decided at compile time: wrong number of arguments,
+unsupported argument type or the spec not matching the argument, are
+compilation errors, not the UCRT crash. each argument is written by
+its own writer, there are no varargs.
+
+arguments: bool, char, integers, floating points, pointers, char const *,
+std::string, std::string_view, std::error_code and everything which has
+the dbj::fmt::frm_arg() overload, dbj::buf::buffer and yanb included
+*/
+namespace dbj {
+	namespace fmt {
+		namespace ct {
+
+			enum class arg_kind { none, boolean, character, integer, floating, pointer, string, error_code };
+
+			struct segment final {
+				// literal or the argument
+				bool is_arg{};
+				// of the literal inside the format string
+				std::size_t begin{};
+				std::size_t size{};
+				// of the argument
+				std::size_t arg{};
+				// 'x', '.' or 0
+				char spec{};
+				int precision{ -1 };
+			};
+
+			// for the DBJ_FMT made types
+			struct format_string_tag {};
+
+			template<typename S>
+			constexpr inline bool is_format_string_v = std::is_base_of_v<format_string_tag, S>;
+
+			/*
+			called only at compile time, thus throwing is the compilation error
+			emit_ is called for each segment
+			*/
+			template<typename F>
+			constexpr void walk(std::string_view fmt_, F && emit_)
+			{
+				const std::size_t n_ = fmt_.size();
+				std::size_t literal_ = 0, k_ = 0, arg_ = 0;
+
+				auto literal_up_to = [&](std::size_t end_) {
+					if (end_ > literal_) {
+						segment seg_{};
+						seg_.begin = literal_;
+						seg_.size = end_ - literal_;
+						emit_(seg_);
+					}
+				};
+
+				while (k_ < n_) {
+					const char c_ = fmt_[k_];
+					if (c_ == '{') {
+						if (k_ + 1 < n_ && fmt_[k_ + 1] == '{') {
+							// "{{" -> "{"
+							literal_up_to(k_ + 1);
+							k_ += 2; literal_ = k_;
+							continue;
+						}
+						literal_up_to(k_);
+						segment seg_{};
+						seg_.is_arg = true;
+						seg_.arg = arg_++;
+						std::size_t j_ = k_ + 1;
+						if (j_ < n_ && fmt_[j_] == ':') {
+							++j_;
+							if (j_ < n_ && fmt_[j_] == 'x') {
+								seg_.spec = 'x'; ++j_;
+							}
+							else if (j_ < n_ && fmt_[j_] == '.') {
+								seg_.spec = '.'; ++j_;
+								seg_.precision = 0;
+								const std::size_t digits_ = j_;
+								while (j_ < n_ && fmt_[j_] >= '0' && fmt_[j_] <= '9')
+									seg_.precision = seg_.precision * 10 + (fmt_[j_++] - '0');
+								if (j_ == digits_)
+									throw "dbj::fmt: digits are expected after '{:.'";
+							}
+							else
+								throw "dbj::fmt: unknown spec, only {:x} and {:.N} are known";
+						}
+						if (j_ >= n_ || fmt_[j_] != '}')
+							throw "dbj::fmt: '}' is expected";
+						emit_(seg_);
+						k_ = j_ + 1; literal_ = k_;
+						continue;
+					}
+					if (c_ == '}') {
+						if (k_ + 1 < n_ && fmt_[k_ + 1] == '}') {
+							literal_up_to(k_ + 1);
+							k_ += 2; literal_ = k_;
+							continue;
+						}
+						throw "dbj::fmt: single '}' found, use '}}'";
+					}
+					++k_;
+				}
+				literal_up_to(n_);
+			}
+
+			constexpr std::size_t count_segments(std::string_view fmt_)
+			{
+				std::size_t count_{};
+				walk(fmt_, [&](segment const &) { ++count_; });
+				return count_;
+			}
+
+			constexpr std::size_t count_args(std::string_view fmt_)
+			{
+				std::size_t count_{};
+				walk(fmt_, [&](segment const & seg_) { if (seg_.is_arg) ++count_; });
+				return count_;
+			}
+
+			template<std::size_t N>
+			constexpr std::array<segment, N> parse(std::string_view fmt_)
+			{
+				std::array<segment, N> segments_{};
+				std::size_t next_{};
+				walk(fmt_, [&](segment const & seg_) { segments_[next_++] = seg_; });
+				return segments_;
+			}
+
+			// the result of the compile time parsing
+			template<typename S>
+			struct parsed final {
+				constexpr static std::string_view text = S::value();
+				constexpr static std::size_t segments_count = count_segments(text);
+				constexpr static std::size_t args_count = count_args(text);
+				constexpr static auto segments =
+					parse<(segments_count > 0 ? segments_count : 1)>(text);
+			};
+
+#pragma region argument kinds
+
+			template<typename T, typename = void>
+			struct frm_arg_result { using type = T; };
+
+			template<typename T>
+			struct frm_arg_result<T, std::void_t<decltype(frm_arg(std::declval<T const &>()))>> {
+				using type = std::decay_t<decltype(frm_arg(std::declval<T const &>()))>;
+			};
+
+			template<typename T>
+			constexpr arg_kind kind_of()
+			{
+				if constexpr (std::is_same_v<T, bool>)
+					return arg_kind::boolean;
+				else if constexpr (std::is_same_v<T, char>)
+					return arg_kind::character;
+				else if constexpr (std::is_same_v<T, wchar_t> ||
+					std::is_same_v<T, char16_t> || std::is_same_v<T, char32_t>)
+					return arg_kind::none;
+				else if constexpr (std::is_integral_v<T> || std::is_enum_v<T>)
+					return arg_kind::integer;
+				else if constexpr (std::is_floating_point_v<T>)
+					return arg_kind::floating;
+				else if constexpr (
+					std::is_same_v<T, char *> || std::is_same_v<T, char const *> ||
+					std::is_same_v<T, std::string> || std::is_same_v<T, std::string_view>)
+					return arg_kind::string;
+				else if constexpr (std::is_same_v<T, std::error_code>)
+					return arg_kind::error_code;
+				else if constexpr (std::is_pointer_v<T> || std::is_null_pointer_v<T>)
+					// wide strings are pointers too, but not here
+					return std::is_same_v<std::remove_cv_t<std::remove_pointer_t<T>>, wchar_t>
+					? arg_kind::none : arg_kind::pointer;
+				else if constexpr (!std::is_same_v<typename frm_arg_result<T>::type, T>)
+					// the frm_arg() overload is found, use its result
+					return kind_of<typename frm_arg_result<T>::type>();
+				else
+					return arg_kind::none;
+			}
+#pragma endregion
+
+#pragma region writers
+			template<typename SINK>
+			inline void put(SINK & sink_, std::string_view sv_)
+			{
+				if (!sv_.empty()) sink_.put(sv_.data(), sv_.size());
+			}
+
+			template<char SPEC, typename SINK, typename T>
+			inline void write_integer(SINK & sink_, T value_)
+			{
+				char buf_[72]{};
+				std::to_chars_result rez_{};
+				if constexpr (std::is_enum_v<T>)
+					return write_integer<SPEC>(sink_, static_cast<std::underlying_type_t<T>>(value_));
+				else {
+					if constexpr (SPEC == 'x')
+						rez_ = std::to_chars(buf_, buf_ + sizeof(buf_), value_, 16);
+					else
+						rez_ = std::to_chars(buf_, buf_ + sizeof(buf_), value_);
+					put(sink_, std::string_view(buf_, std::size_t(rez_.ptr - buf_)));
+				}
+			}
+
+			template<int PRECISION, typename SINK, typename T>
+			inline void write_floating(SINK & sink_, T value_)
+			{
+				const float_chars chars_ = float_to_chars(value_, PRECISION);
+				put(sink_, chars_.view());
+			}
+
+			template<arg_kind KIND, char SPEC, int PRECISION, typename SINK, typename T>
+			inline void write_arg(SINK & sink_, T const & value_)
+			{
+				if constexpr (KIND == arg_kind::boolean) {
+					put(sink_, value_ ? "true" : "false");
+				}
+				else if constexpr (KIND == arg_kind::character) {
+					sink_.put(&value_, 1);
+				}
+				else if constexpr (KIND == arg_kind::integer) {
+					write_integer<SPEC>(sink_, value_);
+				}
+				else if constexpr (KIND == arg_kind::floating) {
+					write_floating<PRECISION>(sink_, value_);
+				}
+				else if constexpr (KIND == arg_kind::error_code) {
+					// the same text as frm_arg() gives
+					if (value_.value() == 0) { put(sink_, "OK"); return; }
+					const std::string message_ = value_.message();
+					put(sink_, message_.empty() ? std::string_view("Empty") : std::string_view(message_));
+				}
+				else if constexpr (std::is_same_v<T, std::string> || std::is_same_v<T, std::string_view>) {
+					put(sink_, value_);
+				}
+				else if constexpr (std::is_same_v<T, char *> || std::is_same_v<T, char const *>) {
+					put(sink_, value_ ? std::string_view(value_) : std::string_view("(null)"));
+				}
+				else if constexpr (KIND == arg_kind::pointer && (std::is_pointer_v<T> || std::is_null_pointer_v<T>)) {
+					put(sink_, "0x");
+					write_integer<'x'>(sink_, reinterpret_cast<std::uintptr_t>(
+						static_cast<void const *>(value_)));
+				}
+				else {
+					// dbj::buf::buffer, yanb, ... go through their frm_arg()
+					using result_type = typename frm_arg_result<T>::type;
+					write_arg<KIND, SPEC, PRECISION>(sink_, static_cast<result_type>(frm_arg(value_)));
+				}
+			}
+#pragma endregion
+
+			template<std::size_t I, typename S, typename SINK, typename TUPLE>
+			inline void write_segment(SINK & sink_, TUPLE const & args_)
+			{
+				using format_ = parsed<S>;
+				constexpr segment seg_ = format_::segments[I];
+				if constexpr (!seg_.is_arg) {
+					sink_.put(format_::text.data() + seg_.begin, seg_.size);
+				}
+				else {
+					using arg_type = std::decay_t<std::tuple_element_t<seg_.arg, TUPLE>>;
+					constexpr arg_kind kind_ = kind_of<arg_type>();
+					static_assert(kind_ != arg_kind::none,
+						"dbj::fmt::format: argument type is not supported");
+					static_assert(seg_.spec != 'x' || kind_ == arg_kind::integer,
+						"dbj::fmt::format: {:x} requires an integer argument");
+					static_assert(seg_.spec != '.' || kind_ == arg_kind::floating,
+						"dbj::fmt::format: {:.N} requires a floating point argument");
+					write_arg<kind_, seg_.spec, seg_.precision>(sink_, std::get<seg_.arg>(args_));
+				}
+			}
+
+			template<typename S, typename SINK, typename TUPLE, std::size_t ... I>
+			inline void write_all(SINK & sink_, TUPLE const & args_, std::index_sequence<I...>)
+			{
+				(write_segment<I, S>(sink_, args_), ...);
+			}
+
+			/*
+			the engine, SINK must have
+				void put(char const *, size_t)
+			*/
+			template<typename S, typename SINK, typename ... Args>
+			inline void format_into(SINK & sink_, Args const & ... args_)
+			{
+				using format_ = parsed<S>;
+				static_assert(format_::args_count == sizeof...(Args),
+					"dbj::fmt::format: number of the {} placeholders and arguments differ");
+				if constexpr (format_::args_count == sizeof...(Args)) {
+					write_all<S>(sink_, std::forward_as_tuple(args_...),
+						std::make_index_sequence<format_::segments_count>{});
+				}
+			}
+
+			/*
+			on the stack first, as to_buff() does
+			spills into the dbj::buf::buffer builder if the stack is not enough
+			*/
+			class stack_sink final
+			{
+				char stack_[to_buff_stack_size];
+				std::size_t size_{};
+				::dbj::buf::buffer spill_{};
+				bool spilled_{};
+
+			public:
+				void put(char const * data_, std::size_t count_)
+				{
+					if (!spilled_) {
+						if (size_ + count_ <= to_buff_stack_size) {
+							std::memcpy(stack_ + size_, data_, count_);
+							size_ += count_;
+							return;
+						}
+						spill_.reserve(2 * (size_ + count_));
+						spill_.append(std::string_view(stack_, size_));
+						spilled_ = true;
+					}
+					spill_.append(std::string_view(data_, count_));
+				}
+
+				::dbj::buf::yanb result()
+				{
+					if (!spilled_) return { stack_, size_ };
+					return spill_.release();
+				}
+			};
+
+#pragma region sinks
+			/*
+			2019-04-03	dbj@dbj.org	format_to() sinks
+
+			anything with void put(char const *, size_t) is a sink
+			*/
+
+			// any output iterator of char
+			template<typename OUT_IT>
+			struct iterator_sink final {
+				OUT_IT out;
+				void put(char const * data_, std::size_t count_)
+				{
+					out = std::copy(data_, data_ + count_, out);
+				}
+			};
+
+			// appends to the dbj::buf::buffer builder
+			struct buffer_sink final {
+				::dbj::buf::buffer & target;
+				void put(char const * data_, std::size_t count_)
+				{
+					target.append(std::string_view(data_, count_));
+				}
+			};
+
+			/*
+			the fixed char array, as snprintf() does it
+			truncates and always zero terminates
+			size is what would have been written if N was large enough
+			*/
+			template<std::size_t N>
+			struct array_sink final {
+				static_assert(N > 0, "dbj::fmt::format_to: char[0] can not be a sink");
+				char (&target)[N];
+				std::size_t size{};
+
+				void put(char const * data_, std::size_t count_) noexcept
+				{
+					if (size < N - 1) {
+						const std::size_t room_ = (std::min)(count_, N - 1 - size);
+						std::memcpy(target + size, data_, room_);
+						target[size + room_] = '\0';
+					}
+					size += count_;
+				}
+			};
+
+			/*
+			for the console and the log
+			output is collected on the stack and given to the FLUSH
+			in zero terminated chunks, when the stack is full, and at the end
+			*/
+			template<typename FLUSH>
+			class chunk_sink final
+			{
+				char stack_[to_buff_stack_size + 1];
+				std::size_t size_{};
+				FLUSH flush_;
+
+				void flush_now_() noexcept
+				{
+					if (size_ < 1) return;
+					stack_[size_] = '\0';
+					flush_(static_cast<char const *>(stack_), size_);
+					size_ = 0;
+				}
+			public:
+				explicit chunk_sink(FLUSH flush_arg_ = FLUSH{}) noexcept : flush_(flush_arg_) {}
+				~chunk_sink() { flush_now_(); }
+
+				chunk_sink(chunk_sink const &) = delete;
+				chunk_sink & operator = (chunk_sink const &) = delete;
+
+				void put(char const * data_, std::size_t count_) noexcept
+				{
+					while (count_ > 0) {
+						if (size_ == to_buff_stack_size) flush_now_();
+						const std::size_t room_ = (std::min)(count_, to_buff_stack_size - size_);
+						std::memcpy(stack_ + size_, data_, room_);
+						size_ += room_; data_ += room_; count_ -= room_;
+					}
+				}
+
+				void flush() noexcept { flush_now_(); }
+			};
+
+			// as fmt::print() does it
+			struct console_flush final {
+				void operator () (char const * chunk_, std::size_t size_) const noexcept
+				{
+					write_stdout(chunk_, size_);
+				}
+			};
+
+			// as core::trace() does it
+			struct trace_flush final {
+				void operator () (char const * chunk_, std::size_t size_) const noexcept
+				{
+#ifdef _WIN32
+					(void)size_;
+					::OutputDebugStringA(chunk_);
+#else
+					std::fwrite(chunk_, 1, size_, stderr);
+#endif
+				}
+			};
+
+			template<typename T, typename = void>
+			struct is_sink : std::false_type {};
+
+			template<typename T>
+			struct is_sink<T, std::void_t<decltype(
+				std::declval<T &>().put(std::declval<char const *>(), std::size_t{}))>>
+				: std::true_type {};
+#pragma endregion sinks
+
+#if defined(__cpp_nontype_template_args) && (__cpp_nontype_template_args >= 201911L)
+			// C++20, string literal as the template argument
+			template<std::size_t N>
+			struct fixed_string final {
+				char data[N]{};
+				constexpr fixed_string(const char(&literal_)[N]) {
+					for (std::size_t k_ = 0; k_ < N; ++k_) data[k_] = literal_[k_];
+				}
+			};
+
+			template<fixed_string F>
+			struct fixed_format final : format_string_tag {
+				constexpr static std::string_view value() noexcept {
+					return { F.data, sizeof(F.data) - 1 };
+				}
+			};
+#define DBJ_FMT_FIXED_STRING
+#endif
+		} // ct
+
+		// C++17, DBJ_FMT("...") makes the format string type
+		template<typename S, typename ... Args,
+			std::enable_if_t<ct::is_format_string_v<S>, int> = 0 >
+		inline ::dbj::buf::yanb format(S, Args const & ... args_)
+		{
+			ct::stack_sink sink_{};
+			ct::format_into<S>(sink_, args_...);
+			return sink_.result();
+		}
+
+/*
+		2019-04-03	dbj@dbj.org	format_to()
+
+		into the caller's sink, nothing is allocated here
+
+			char line_[0xFF]{};
+			dbj::fmt::format_to( line_, DBJ_FMT("{}: {}"), k, v ) ;
+
+			dbj::buf::buffer report_ ;
+			for ( ... )
+				dbj::fmt::format_to( report_, DBJ_FMT("{}\n"), k ) ;
+
+			dbj::fmt::format_to( std::back_inserter(str_), DBJ_FMT("{:x}"), 255 ) ;
+			dbj::fmt::format_to( dbj::fmt::console_sink{}, DBJ_FMT("{}"), 42 ) ;
+		*/
+		using console_sink = ct::chunk_sink<ct::console_flush>;
+		using trace_sink = ct::chunk_sink<ct::trace_flush>;
+
+		// appends, returns the buffer
+		template<typename S, typename ... Args,
+			std::enable_if_t<ct::is_format_string_v<S>, int> = 0 >
+		inline ::dbj::buf::buffer & format_to(::dbj::buf::buffer & target_, S, Args const & ... args_)
+		{
+			ct::buffer_sink sink_{ target_ };
+			ct::format_into<S>(sink_, args_...);
+			return target_;
+		}
+
+		// truncates, zero terminates, returns the size required, as snprintf does
+		template<std::size_t N, typename S, typename ... Args,
+			std::enable_if_t<ct::is_format_string_v<S>, int> = 0 >
+		inline std::size_t format_to(char (&target_)[N], S, Args const & ... args_) noexcept
+		{
+			ct::array_sink<N> sink_{ target_ };
+			target_[0] = '\0';
+			ct::format_into<S>(sink_, args_...);
+			return sink_.size;
+		}
+
+		// console_sink, trace_sink or any other sink
+		template<typename SINK, typename S, typename ... Args,
+			std::enable_if_t<ct::is_format_string_v<S> &&
+				ct::is_sink<std::remove_reference_t<SINK>>::value, int> = 0 >
+		inline void format_to(SINK && sink_, S, Args const & ... args_)
+		{
+			ct::format_into<S>(sink_, args_...);
+		}
+
+		// output iterator, returns the iterator past the output
+		template<typename OUT_IT, typename S, typename ... Args,
+			std::enable_if_t<ct::is_format_string_v<S> &&
+				!ct::is_sink<std::remove_reference_t<OUT_IT>>::value &&
+				!std::is_array_v<std::remove_reference_t<OUT_IT>> &&
+				!std::is_same_v<std::decay_t<OUT_IT>, ::dbj::buf::buffer>, int> = 0 >
+		inline OUT_IT format_to(OUT_IT out_, S, Args const & ... args_)
+		{
+			ct::iterator_sink<OUT_IT> sink_{ out_ };
+			ct::format_into<S>(sink_, args_...);
+			return sink_.out;
+		}
+
+		// to the console, no temporary buffer
+		template<typename S, typename ... Args,
+			std::enable_if_t<ct::is_format_string_v<S>, int> = 0 >
+		inline void print(S, Args const & ... args_)
+		{
+			console_sink sink_{};
+			ct::format_into<S>(sink_, args_...);
+		}
+
+#ifdef DBJ_FMT_FIXED_STRING
+		// C++20, dbj::fmt::format<"...">( args ... )
+		template<ct::fixed_string F, typename ... Args>
+		inline ::dbj::buf::yanb format(Args const & ... args_)
+		{
+			return format(ct::fixed_format<F>{}, args_...);
+		}
+
+		// C++20, dbj::fmt::format_to<"...">( sink, args ... )
+		template<ct::fixed_string F, typename SINK, typename ... Args>
+		inline decltype(auto) format_to(SINK && sink_, Args const & ... args_)
+		{
+			return format_to(std::forward<SINK>(sink_), ct::fixed_format<F>{}, args_...);
+		}
+#endif
+	} // fmt
+} // dbj
+
+/*
+the format string type, made in place, C++17 has no string literals
+as template arguments
+*/
+#define DBJ_FMT(s_) \
+	[]() noexcept { \
+		struct dbj_format_string_ final : ::dbj::fmt::ct::format_string_tag { \
+			constexpr static std::string_view value() noexcept { return s_; } \
+		}; \
+		return dbj_format_string_{}; \
+	}()
@@ -0,0 +1,230 @@
+#pragma once
+
+#include "../dbj_gpl_license.h"
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <new>
+
+/*
+2019-03-18	dbj@dbj.org	created
+
+thread local size class pool for the dbj buffers
+
+dbj::buf::max_length is 64KB, thus power of two bins
+from 16 bytes to 64KB are all that is needed.
+Each thread has its own free lists, so there is no locking.
+Blocks freed on one thread go to that thread free lists,
+they are just malloc-ed memory and can migrate freely.
+
+Anything bigger than 64KB goes straight to malloc/free.
+*/
+namespace dbj {
+	namespace buf {
+
+		struct pool_stats final {
+			// served from the free lists
+			std::size_t hits{};
+			// had to call malloc
+			std::size_t misses{};
+			// bytes sitting in the free lists
+			std::size_t bytes_resident{};
+		};
+
+		class size_class_pool final
+		{
+		public:
+			constexpr static std::size_t min_block_shift = 4;  // 16 bytes
+			constexpr static std::size_t max_block_shift = 16; // 64KB
+			constexpr static std::size_t bins_count = max_block_shift - min_block_shift + 1;
+			constexpr static std::size_t max_block_size = std::size_t(1) << max_block_shift;
+			// how much one bin is allowed to keep
+			constexpr static std::size_t bin_bytes_limit = 0x40000; // 256KB
+
+		private:
+			struct free_block final { free_block * next; };
+
+			struct bin final {
+				free_block * head{};
+				std::size_t count{};
+			};
+
+			bin bins_[bins_count]{};
+			pool_stats stats_{};
+
+			/*
+			this one has no destructor thus it is usable after
+			the pool of this thread is gone, for example from the
+			destructors of the static objects
+			*/
+			static bool & is_gone() noexcept {
+				static thread_local bool gone_{};
+				return gone_;
+			}
+
+			// 16 -> 0, 17..32 -> 1, ... 64KB -> 12
+			static std::size_t bin_index(std::size_t bytes_) noexcept
+			{
+				std::size_t index_{};
+				std::size_t size_ = std::size_t(1) << min_block_shift;
+				while (size_ < bytes_) { size_ <<= 1; ++index_; }
+				return index_;
+			}
+
+			static std::size_t bin_size(std::size_t index_) noexcept
+			{
+				return std::size_t(1) << (index_ + min_block_shift);
+			}
+
+			size_class_pool() noexcept = default;
+
+		public:
+			size_class_pool(size_class_pool const &) = delete;
+			size_class_pool & operator = (size_class_pool const &) = delete;
+
+			~size_class_pool()
+			{
+				for (auto & bin_ : bins_) {
+					while (bin_.head) {
+						free_block * next_ = bin_.head->next;
+						std::free(bin_.head);
+						bin_.head = next_;
+					}
+				}
+				is_gone() = true;
+			}
+
+			// the pool of the calling thread
+			static size_class_pool & instance() noexcept
+			{
+				static thread_local size_class_pool pool_{};
+				return pool_;
+			}
+
+			[[nodiscard]] static void * allocate(std::size_t bytes_) noexcept
+			{
+				if (bytes_ > max_block_size)
+					return std::malloc(bytes_);
+
+				const std::size_t index_ = bin_index(bytes_);
+				// always the full bin size, the block might be
+				// deallocated on some other thread, into its pool
+				if (is_gone())
+					return std::malloc(bin_size(index_));
+
+				size_class_pool & pool_ = instance();
+				bin & bin_ = pool_.bins_[index_];
+
+				if (bin_.head) {
+					free_block * block_ = bin_.head;
+					bin_.head = block_->next;
+					bin_.count -= 1;
+					pool_.stats_.hits += 1;
+					pool_.stats_.bytes_resident -= bin_size(index_);
+					return block_;
+				}
+				pool_.stats_.misses += 1;
+				return std::malloc(bin_size(index_));
+			}
+
+			// bytes_ must be the same as given to the allocate()
+			static void deallocate(void * block_, std::size_t bytes_) noexcept
+			{
+				if (!block_) return;
+
+				if (bytes_ > max_block_size || is_gone()) {
+					std::free(block_);
+					return;
+				}
+
+				size_class_pool & pool_ = instance();
+				const std::size_t index_ = bin_index(bytes_);
+				bin & bin_ = pool_.bins_[index_];
+
+				if ((bin_.count + 1) * bin_size(index_) > bin_bytes_limit) {
+					std::free(block_);
+					return;
+				}
+
+				free_block * free_ = ::new (block_) free_block{ bin_.head };
+				bin_.head = free_;
+				bin_.count += 1;
+				pool_.stats_.bytes_resident += bin_size(index_);
+			}
+
+			// counters of the calling thread
+			static pool_stats stats() noexcept {
+				if (is_gone()) return {};
+				return instance().stats_;
+			}
+		}; // size_class_pool
+
+		/*
+		std allocator on top of the size_class_pool
+		used for the std::shared_ptr control blocks
+		*/
+		template<typename T>
+		struct pool_allocator final
+		{
+			using value_type = T;
+
+			pool_allocator() noexcept = default;
+			template<typename U>
+			pool_allocator(pool_allocator<U> const &) noexcept {}
+
+			[[nodiscard]] T * allocate(std::size_t n_)
+			{
+				void * p_ = size_class_pool::allocate(n_ * sizeof(T));
+				if (!p_) throw std::bad_alloc();
+				return static_cast<T *>(p_);
+			}
+
+			void deallocate(T * p_, std::size_t n_) noexcept
+			{
+				size_class_pool::deallocate(p_, n_ * sizeof(T));
+			}
+
+			template<typename U>
+			bool operator == (pool_allocator<U> const &) const noexcept { return true; }
+			template<typename U>
+			bool operator != (pool_allocator<U> const &) const noexcept { return false; }
+		};
+
+		/*
+		allocation policy for dbj::buf::smart_buf
+		count_ chars are allocated, they are not initialized
+		the block goes back to the pool when the last owner is gone
+		*/
+		struct pooled_allocation final
+		{
+			// the pool blocks are malloc-ed
+			constexpr static std::size_t alignment = alignof(std::max_align_t);
+			constexpr static std::size_t padding = 0;
+
+			template<typename C>
+			static std::shared_ptr<C> block(std::size_t count_) noexcept
+			{
+				const std::size_t bytes_ = count_ * sizeof(C);
+				C * block_ = static_cast<C *>(size_class_pool::allocate(bytes_));
+				assert(block_);
+				return std::shared_ptr<C>(
+					block_,
+					[bytes_](C * p_) noexcept { size_class_pool::deallocate(p_, bytes_); },
+					pool_allocator<C>{}
+				);
+			}
+
+			// raw blocks, for the non shared ownership policies
+			static void * allocate(std::size_t bytes_) noexcept {
+				return size_class_pool::allocate(bytes_);
+			}
+			static void deallocate(void * block_, std::size_t bytes_) noexcept {
+				size_class_pool::deallocate(block_, bytes_);
+			}
+		};
+
+	} // buf
+} // dbj
@@ -1,10 +1,66 @@
 #pragma once
 
 // does not require any include before
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
 #include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
 
-// Multi Threaded Build Switch
-#define DBJ_AUTO_LOCK dbj::sync::lock_unlock __dbj_auto_lock__ 
+#if __has_include(<version>)
+#include <version>
+#endif
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define DBJ_SYNC_PAUSE() _mm_pause()
+#else
+#define DBJ_SYNC_PAUSE() std::atomic_signal_fence(std::memory_order_seq_cst)
+#endif
+
+#define DBJ_SYNC_CONCAT_IMPL( x, y ) x##y
+#define DBJ_SYNC_CONCAT( x, y ) DBJ_SYNC_CONCAT_IMPL( x, y )
+
+/*
+2019-04-06	dbj@dbj.org
+
+Multi Threaded Build Switch
+each DBJ_SITE_LOCK site has its own static mutex, thus the
+unrelated sites do not wait on each other
+
+	void safe_fun ( ) {
+		DBJ_SITE_LOCK ;
+		...
+	}
+
+the site mutex is not recursive, a site must not be re-entered
+where a getter and a setter must exclude each other, both lock
+the one named lock object
+
+	inline dbj::sync::site_lock config_lock_{ __FILE__, __LINE__ };
+	T    get ( )       { DBJ_NAMED_LOCK(config_lock_); return config_; }
+	void set ( T v_ )  { DBJ_NAMED_LOCK(config_lock_); config_ = v_; }
+
+with DBJ_SYNC_STATS defined, each site counts its acquisitions,
+contended acquisitions and time spent waiting, see dbj::sync::for_each_site()
+
+DBJ_AUTO_LOCK is the one process wide recursive mutex, all its
+users exclude each other, it is kept only for the old code
+which relies on re-entering it
+*/
+#define DBJ_AUTO_LOCK \
+	::dbj::sync::lock_unlock DBJ_SYNC_CONCAT(dbj_auto_lock_, __LINE__)
+
+#define DBJ_NAMED_LOCK(lock_) \
+	std::lock_guard<::dbj::sync::site_lock> DBJ_SYNC_CONCAT(dbj_auto_lock_, __LINE__){ lock_ }
+
+#define DBJ_SITE_LOCK \
+	static ::dbj::sync::site_lock DBJ_SYNC_CONCAT(dbj_site_lock_, __LINE__){ __FILE__, __LINE__ }; \
+	DBJ_NAMED_LOCK(DBJ_SYNC_CONCAT(dbj_site_lock_, __LINE__))
 
 namespace dbj {
 
@@ -14,29 +70,454 @@ namespace dbj {
 	/// </summary>
 	namespace sync {
 
+#pragma region stats policies
+		/// <summary>
+		/// locks do not count, the default
+		/// </summary>
+		struct no_stats final {
+			constexpr static bool enabled = false;
+			void acquired() noexcept {}
+			void acquired_after(std::uint64_t) noexcept {}
+		};
+
 		/// <summary>
-		/// automatic use of std::mutex 
-		/// example of making a function
-		/// thread safe
+		/// acquisitions, contended acquisitions and the
+		/// nanoseconds spent waiting on the contended ones
+		/// to find the hot locks
+		/// </summary>
+		struct lock_stats final {
+			constexpr static bool enabled = true;
+
+			std::atomic<std::uint64_t> acquisitions{};
+			std::atomic<std::uint64_t> contended{};
+			std::atomic<std::uint64_t> wait_ns{};
+
+			void acquired() noexcept {
+				acquisitions.fetch_add(1, std::memory_order_relaxed);
+			}
+			void acquired_after(std::uint64_t wait_ns_) noexcept {
+				acquisitions.fetch_add(1, std::memory_order_relaxed);
+				contended.fetch_add(1, std::memory_order_relaxed);
+				wait_ns.fetch_add(wait_ns_, std::memory_order_relaxed);
+			}
+			void reset() noexcept {
+				acquisitions = 0; contended = 0; wait_ns = 0;
+			}
+		};
+
+		namespace inner {
+			inline std::uint64_t now_ns() noexcept {
+				return std::uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+					std::chrono::steady_clock::now().time_since_epoch()).count());
+			}
+		}
+#pragma endregion
+
+		/// <summary>
+		/// any std mutex, counted by the STATS
+		/// try first, thus uncontended acquisitions are not timed
+		/// for std::shared_mutex the shared side is counted too
+		/// use with std::lock_guard, std::unique_lock, std::shared_lock
+		/// </summary>
+		template<typename MUTEX, typename STATS = no_stats>
+		class counted_lock
+		{
+			MUTEX mux_{};
+			STATS stats_{};
+		public:
+			using mutex_type = MUTEX;
+			using stats_type = STATS;
+
+			counted_lock() noexcept = default;
+			counted_lock(counted_lock const &) = delete;
+			counted_lock & operator = (counted_lock const &) = delete;
+
+			void lock() {
+				if constexpr (STATS::enabled) {
+					if (mux_.try_lock()) { stats_.acquired(); return; }
+					const auto start_ = inner::now_ns();
+					mux_.lock();
+					stats_.acquired_after(inner::now_ns() - start_);
+				}
+				else mux_.lock();
+			}
+			bool try_lock() {
+				if (!mux_.try_lock()) return false;
+				stats_.acquired();
+				return true;
+			}
+			void unlock() { mux_.unlock(); }
+
+			template<typename M = MUTEX>
+			auto lock_shared() -> decltype(std::declval<M &>().lock_shared()) {
+				if constexpr (STATS::enabled) {
+					if (mux_.try_lock_shared()) { stats_.acquired(); return; }
+					const auto start_ = inner::now_ns();
+					mux_.lock_shared();
+					stats_.acquired_after(inner::now_ns() - start_);
+				}
+				else mux_.lock_shared();
+			}
+			template<typename M = MUTEX>
+			auto try_lock_shared() -> decltype(std::declval<M &>().try_lock_shared()) {
+				if (!mux_.try_lock_shared()) return false;
+				stats_.acquired();
+				return true;
+			}
+			template<typename M = MUTEX>
+			auto unlock_shared() -> decltype(std::declval<M &>().unlock_shared()) {
+				mux_.unlock_shared();
+			}
+
+			STATS const & stats() const noexcept { return stats_; }
+			STATS & stats() noexcept { return stats_; }
+		};
+
+		/// <summary>
+		/// reader-writer lock
+		/// <code>
+		/// std::shared_lock reader_( rw_ ) ; // many at once
+		/// std::lock_guard writer_( rw_ ) ;  // one, alone
+		/// </code>
+		/// </summary>
+		template<typename STATS = no_stats>
+		using rw_lock = counted_lock<std::shared_mutex, STATS>;
+
+		/// <summary>
+		/// adaptive lock, for the short critical sections
+		/// spins first, with the growing pause, then parks the thread
+		/// 0 is free, 1 is locked, 2 is locked with the threads parked
+		/// without C++20 atomic wait, parking is yielding
+		/// </summary>
+		template<typename STATS = no_stats>
+		class adaptive_lock final
+		{
+			std::atomic<int> state_{ 0 };
+			STATS stats_{};
+
+			bool acquire_() noexcept {
+				int free_ = 0;
+				return state_.compare_exchange_strong(free_, 1,
+					std::memory_order_acquire, std::memory_order_relaxed);
+			}
+
+			void park_() noexcept {
+#if defined(__cpp_lib_atomic_wait) && (__cpp_lib_atomic_wait >= 201907L)
+				state_.wait(2, std::memory_order_relaxed);
+#else
+				std::this_thread::yield();
+#endif
+			}
+
+			void contended_lock_() noexcept {
+				// spin
+				for (int round_ = 0, pause_ = 1; round_ < spin_rounds; ++round_) {
+					for (int k_ = 0; k_ < pause_; ++k_) DBJ_SYNC_PAUSE();
+					if (pause_ < 64) pause_ *= 2;
+					if (state_.load(std::memory_order_relaxed) == 0 && acquire_())
+						return;
+				}
+				// park, and mark the lock as having the parked threads
+				while (state_.exchange(2, std::memory_order_acquire) != 0)
+					park_();
+			}
+
+		public:
+			// spinning rounds before parking
+			constexpr static int spin_rounds = 16;
+
+			adaptive_lock() noexcept = default;
+			adaptive_lock(adaptive_lock const &) = delete;
+			adaptive_lock & operator = (adaptive_lock const &) = delete;
+
+			bool try_lock() noexcept {
+				if (!acquire_()) return false;
+				stats_.acquired();
+				return true;
+			}
+
+			void lock() noexcept {
+				if (acquire_()) { stats_.acquired(); return; }
+				if constexpr (STATS::enabled) {
+					const auto start_ = inner::now_ns();
+					contended_lock_();
+					stats_.acquired_after(inner::now_ns() - start_);
+				}
+				else contended_lock_();
+			}
+
+			void unlock() noexcept {
+				if (state_.exchange(0, std::memory_order_release) == 2) {
+#if defined(__cpp_lib_atomic_wait) && (__cpp_lib_atomic_wait >= 201907L)
+					state_.notify_one();
+#endif
+				}
+			}
+
+			STATS const & stats() const noexcept { return stats_; }
+			STATS & stats() noexcept { return stats_; }
+		};
+
+#ifdef DBJ_SYNC_STATS
+		using site_stats = lock_stats;
+#else
+		using site_stats = no_stats;
+#endif
+
+		/// <summary>
+		/// the one process wide recursive mutex
+		/// thus threads do wait on each other
+		/// this is the DBJ_AUTO_LOCK, only for the code re-entering it
 		/// <code>
 		/// void safe_fun ( ) {
 		/// dbj::sync::lock_unlock auto_lock_ ;
-		/// or
-		/// DBJ_AUTO_LOCK
 		/// }
 		/// </code>
 		/// </summary>
 		struct lock_unlock final {
-			
-			mutable std::mutex mux_;
 
-			 lock_unlock() noexcept { mux_.lock(); }
-			~lock_unlock() { mux_.unlock(); }
+			static std::recursive_mutex & mutex() noexcept {
+				static std::recursive_mutex mux_;
+				return mux_;
+			}
+
+			 lock_unlock() noexcept { mutex().lock(); }
+			~lock_unlock() { mutex().unlock(); }
+
+			lock_unlock(lock_unlock const &) = delete;
+			lock_unlock & operator = (lock_unlock const &) = delete;
+		};
+
+		/// <summary>
+		/// the lock behind the DBJ_SITE_LOCK and DBJ_NAMED_LOCK
+		/// each one has its own std::mutex and its own stats
+		/// all the sites are in the one lock free list
+		/// </summary>
+		class site_lock final
+		{
+			inline static std::atomic<site_lock const *> head_{ nullptr };
+			site_lock const * next_{};
+			std::mutex mux_{};
+			site_stats stats_{};
+		public:
+			char const * const file;
+			unsigned const line;
+
+			site_lock(char const * file_, unsigned line_) noexcept
+				: file(file_), line(line_)
+			{
+				next_ = head_.load(std::memory_order_relaxed);
+				while (!head_.compare_exchange_weak(next_, this,
+					std::memory_order_release, std::memory_order_relaxed))
+					;
+			}
+
+			site_lock(site_lock const &) = delete;
+			site_lock & operator = (site_lock const &) = delete;
+
+			// try first, thus uncontended acquisitions are not timed
+			void lock() {
+				if constexpr (site_stats::enabled) {
+					if (mux_.try_lock()) { stats_.acquired(); return; }
+					const auto start_ = inner::now_ns();
+					mux_.lock();
+					stats_.acquired_after(inner::now_ns() - start_);
+				}
+				else mux_.lock();
+			}
+			bool try_lock() {
+				if (!mux_.try_lock()) return false;
+				stats_.acquired();
+				return true;
+			}
+			void unlock() { mux_.unlock(); }
+
+			site_stats const & stats() const noexcept { return stats_; }
+			site_stats & stats() noexcept { return stats_; }
+
+			/// callback_ receives site_lock const &
+			template<typename F>
+			static void for_each(F callback_)
+			{
+				for (site_lock const * site_ = head_.load(std::memory_order_acquire);
+					site_; site_ = site_->next_)
+					callback_(*site_);
+			}
 		};
 
+		/// <summary>
+		/// visit all the DBJ_SITE_LOCK sites entered so far
+		/// and all the named site locks constructed so far
+		/// with DBJ_SYNC_STATS defined, find the hot ones
+		/// <code>
+		/// dbj::sync::for_each_site( [] ( auto const & site_ ) {
+		///		report( site_.file, site_.line, site_.stats().contended ) ;
+		/// });
+		/// </code>
+		/// </summary>
+		template<typename F>
+		inline void for_each_site(F callback_) { site_lock::for_each(callback_); }
+
+		namespace inner {
+
+			enum class guardian_kind { atomic, seqlock, locked };
+
+			template<typename T>
+			constexpr guardian_kind guardian_kind_of() noexcept
+			{
+				if constexpr (!std::is_trivially_copyable_v<T>)
+					return guardian_kind::locked;
+				else if constexpr (sizeof(T) <= 16 && std::atomic<T>::is_always_lock_free)
+					return guardian_kind::atomic;
+				else
+					return guardian_kind::seqlock;
+			}
+
+			template<typename T, guardian_kind KIND = guardian_kind_of<T>()>
+			class guarded;
+
+			// std::atomic, no locks at all
+			template<typename T>
+			class guarded<T, guardian_kind::atomic> final
+			{
+				std::atomic<T> treasure_{};
+			public:
+				guarded() noexcept = default;
+				explicit guarded(T const & init_) noexcept : treasure_(init_) {}
+
+				T load() const noexcept { return treasure_.load(std::memory_order_acquire); }
+				void store(T const & new_) noexcept { treasure_.store(new_, std::memory_order_release); }
+
+				template<typename F>
+				T update(F && fun_) {
+					T old_ = treasure_.load(std::memory_order_relaxed);
+					T new_{};
+					do {
+						new_ = old_;
+						fun_(new_);
+					} while (!treasure_.compare_exchange_weak(old_, new_,
+						std::memory_order_acq_rel, std::memory_order_relaxed));
+					return new_;
+				}
+			};
+
+			/*
+			seqlock
+			writers never wait for the readers, they only take turns between themselves,
+			by making the sequence odd. readers copy and retry if the sequence was odd or
+			has moved. the value is kept in atomic words, so the copy being overwritten
+			is not a data race, it is just thrown away.
+			*/
+			template<typename T>
+			class guarded<T, guardian_kind::seqlock> final
+			{
+				using word_type = std::size_t;
+				constexpr static std::size_t words_count = (sizeof(T) + sizeof(word_type) - 1) / sizeof(word_type);
+
+				std::atomic<std::size_t> sequence_{ 0 };
+				std::atomic<word_type> words_[words_count]{};
+
+				void write_words_(T const & new_) noexcept {
+					word_type words_copy_[words_count]{};
+					std::memcpy(words_copy_, &new_, sizeof(T));
+					for (std::size_t k_ = 0; k_ < words_count; ++k_)
+						words_[k_].store(words_copy_[k_], std::memory_order_relaxed);
+				}
+
+				T read_words_() const noexcept {
+					word_type words_copy_[words_count]{};
+					for (std::size_t k_ = 0; k_ < words_count; ++k_)
+						words_copy_[k_] = words_[k_].load(std::memory_order_relaxed);
+					T value_;
+					std::memcpy(&value_, words_copy_, sizeof(T));
+					return value_;
+				}
+
+				// returns the odd sequence
+				std::size_t begin_write_() noexcept {
+					std::size_t seq_ = sequence_.load(std::memory_order_relaxed);
+					for (;;) {
+						if ((seq_ & 1) == 0 && sequence_.compare_exchange_weak(seq_, seq_ + 1,
+							std::memory_order_acquire, std::memory_order_relaxed))
+							break;
+						DBJ_SYNC_PAUSE();
+						seq_ = sequence_.load(std::memory_order_relaxed);
+					}
+					// the words are not written before the sequence is odd
+					std::atomic_thread_fence(std::memory_order_release);
+					return seq_ + 1;
+				}
+
+				void end_write_(std::size_t odd_) noexcept {
+					sequence_.store(odd_ + 1, std::memory_order_release);
+				}
+
+			public:
+				guarded() noexcept { write_words_(T{}); }
+				explicit guarded(T const & init_) noexcept { write_words_(init_); }
+
+				T load() const noexcept {
+					for (;;) {
+						const std::size_t before_ = sequence_.load(std::memory_order_acquire);
+						if (before_ & 1) { DBJ_SYNC_PAUSE(); continue; }
+						T value_ = read_words_();
+						std::atomic_thread_fence(std::memory_order_acquire);
+						if (sequence_.load(std::memory_order_relaxed) == before_)
+							return value_;
+					}
+				}
+
+				void store(T const & new_) noexcept {
+					const std::size_t odd_ = begin_write_();
+					write_words_(new_);
+					end_write_(odd_);
+				}
+
+				template<typename F>
+				T update(F && fun_) {
+					const std::size_t odd_ = begin_write_();
+					T value_ = read_words_();
+					fun_(value_);
+					write_words_(value_);
+					end_write_(odd_);
+					return value_;
+				}
+			};
+
+			// not trivially copyable, many readers or one writer
+			template<typename T>
+			class guarded<T, guardian_kind::locked> final
+			{
+				mutable rw_lock<> lock_{};
+				T treasure_{};
+			public:
+				guarded() = default;
+				explicit guarded(T const & init_) : treasure_(init_) {}
+
+				T load() const {
+					std::shared_lock<rw_lock<>> reader_(lock_);
+					return treasure_;
+				}
+				void store(T const & new_) {
+					std::lock_guard<rw_lock<>> writer_(lock_);
+					treasure_ = new_;
+				}
+				template<typename F>
+				T update(F && fun_) {
+					std::lock_guard<rw_lock<>> writer_(lock_);
+					fun_(treasure_);
+					return treasure_;
+				}
+			};
+		} // inner
+
 		/// <summary>
 		/// in presence of multiple threads
 		/// guard value of type T
+		/// load() returns the copy, never the reference
+		/// trivially copyable T up to 16 bytes, lock free: std::atomic
+		/// the other trivially copyable T: seqlock, readers never lock
+		/// the rest: reader-writer lock
 		/// example
 		/// <code>
 		/// static inline guardian<bool> signal_ ;
@@ -47,24 +528,38 @@ namespace dbj {
 		/// </code>
 		/// switch to true
 		/// <code>
-		/// auto true_ = signal_.load(true) ;
+		/// signal_.store(true) ;
+		/// </code>
+		/// change in place, the result is returned
+		/// <code>
+		/// auto point_ = guarded_point_.update( [](point & p_) { p_.x += 1; } ) ;
 		/// </code>
 		/// </summary>
 		template <typename T>
-		struct __declspec(novtable) guardian final 
+		struct __declspec(novtable) guardian final
 		{
 			typedef T value_type;
+			constexpr static inner::guardian_kind kind = inner::guardian_kind_of<T>();
 
-			value_type & load() const noexcept  {
-				lock_unlock locker_;
-				return treasure_;
+			guardian() = default;
+			explicit guardian(value_type const & init_) : treasure_(init_) {}
+
+			guardian(guardian const &) = delete;
+			guardian & operator = (guardian const &) = delete;
+
+			value_type load() const noexcept(kind != inner::guardian_kind::locked) {
+				return treasure_.load();
+			}
+			value_type store(value_type const & new_value) const noexcept(kind != inner::guardian_kind::locked) {
+				treasure_.store(new_value);
+				return new_value;
 			}
-			value_type & store(value_type new_value) const noexcept {
-				lock_unlock locker_;
-				return treasure_ = new_value;
+			template<typename F>
+			value_type update(F && fun_) const {
+				return treasure_.update(std::forward<F>(fun_));
 			}
 		private:
-			mutable value_type treasure_ ;
+			mutable inner::guarded<value_type> treasure_ ;
 		};
 
 
@@ -72,4 +567,4 @@ namespace dbj {
 } // dbj
 
 /* inclusion of this file defines the kind of a licence used */
-#include "../dbj_gpl_license.h"
\ No newline at end of file
+#include "../dbj_gpl_license.h"
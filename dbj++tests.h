@@ -21,6 +21,9 @@
 #define dbj_static_matrix_test 
 // #define dbj_any_optional_tests
 
+// benchmarks inside the test units are opt in, they take long
+// #define dbj_benchmarks
+
 
 #ifdef dbj_buffer_testing
 #include "test\dbj_buffer_testing.h"  
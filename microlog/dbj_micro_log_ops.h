@@ -4,11 +4,28 @@
 #include "dbj_micro_log_fwd.h"
 #include "dbj_app_env.h"
 #include "dbj_string_util.h"
+#include "dbj_format.h"
 
 namespace dbj::log {
 
 	using dbj::log::outstream_type; // std::wostringstream this is
 
+	/*
+	floating points through the dbj::fmt::float_to_chars
+	the shortest round trip, not the 6 digits of the stream default
+	declared before the internal lambdas, so that they are found from there
+	*/
+	template<typename T, std::enable_if_t<std::is_floating_point_v<T>, int> = 0 >
+	inline outstream_type & operator<<
+		(outstream_type & os, T x_)
+	{
+		const auto chars_ = dbj::fmt::float_to_chars(x_);
+		wchar_t wide_[sizeof(chars_.data)]{};
+		std::copy(chars_.data, chars_.data + chars_.size, wide_);
+		os.write(wide_, chars_.size);
+		return os;
+	}
+
 	namespace internal {
 		constexpr char space = ' ', prefix = '{', suffix = '}', delim = ',';
 
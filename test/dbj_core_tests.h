@@ -51,6 +51,103 @@ DBJ_TEST_UNIT(core_format_utils)
 	print("\nchar_buffer\n\t%s",::dbj::buf::buffer("hello!"));
 }
 
+DBJ_TEST_UNIT(core_format_to_buff)
+{
+	using ::dbj::fmt::to_buff;
+	using ::dbj::fmt::to_buff_stack_size;
+
+	// short, sso, no heap at all
+	DBJ_TEST_ATOM(to_buff("%d + %d", 1, 1).is_sso());
+	// formatted on the stack, copied once
+	DBJ_TEST_ATOM(to_buff("%s", std::string(to_buff_stack_size / 2, '*')).size());
+	// overflow, formatted into the exactly sized heap block
+	DBJ_TEST_ATOM(to_buff("%s", std::string(to_buff_stack_size * 2, '*')).size());
+	DBJ_TEST_ATOM(to_buff(L"%s", std::wstring(to_buff_stack_size * 2, L'*')).size());
+}
+
+DBJ_TEST_UNIT(core_format_compile_time)
+{
+	using ::dbj::fmt::format;
+
+	// format string is parsed at compile time
+	// wrong number or type of arguments does not compile
+	DBJ_TEST_ATOM(format(DBJ_FMT("{} + {} = {}"), 1, 1, 2));
+	DBJ_TEST_ATOM(format(DBJ_FMT("{:x} {:.2} {} {{}}"), 255, 3.14159, true));
+	DBJ_TEST_ATOM(format(DBJ_FMT("{} {} {}"), ::dbj::buf::buffer("hello!"), std::error_code{}, "text"));
+#ifdef DBJ_FMT_FIXED_STRING
+	DBJ_TEST_ATOM(format<"{} is {:x}">("255", 255));
+#endif
+}
+
+DBJ_TEST_UNIT(core_format_to_sinks)
+{
+	using ::dbj::fmt::format_to;
+
+	// truncated, zero terminated, the size required is returned
+	char line_[8]{};
+	DBJ_TEST_ATOM(format_to(line_, DBJ_FMT("{}-{}"), 12345, "abcdef"));
+	DBJ_TEST_ATOM(std::string_view(line_));
+
+	// one buffer reused in the loop
+	::dbj::buf::buffer report_;
+	for (int k = 0; k < 0xF; ++k) {
+		format_to(report_, DBJ_FMT("{:x};"), k);
+	}
+	DBJ_TEST_ATOM(report_.view);
+
+	std::string str_;
+	format_to(std::back_inserter(str_), DBJ_FMT("{} {}"), 1, 2.5);
+	DBJ_TEST_ATOM(str_);
+
+	::dbj::fmt::print(DBJ_FMT("\n\nprinted directly, {} {}"), true, 42);
+}
+
+DBJ_TEST_UNIT(core_float_to_chars)
+{
+	using ::dbj::fmt::float_to_chars;
+
+	_ASSERTE(float_to_chars(0.1).view() == "0.1");
+	_ASSERTE(float_to_chars(0.1f).view() == "0.1");
+	_ASSERTE(float_to_chars(3.14159, 2).view() == "3.14");
+	_ASSERTE(float_to_chars(-2.5).view() == "-2.5");
+	DBJ_TEST_ATOM(float_to_chars(1.0L / 3).view());
+
+	// the shortest form reads back to the same value
+	for (double value_ : { 0.0, 1.0 / 3, -1e-300, 6.02214076e23, 31.415926535 / 7.0, 1e300 })
+		_ASSERTE(std::strtod(float_to_chars(value_).data, nullptr) == value_);
+}
+
+#ifdef dbj_benchmarks
+DBJ_TEST_UNIT(core_float_to_chars_throughput)
+{
+	using ::dbj::fmt::float_to_chars;
+
+	// the printf path, against the to_chars backend
+	std::vector<double> values_(0x10000);
+	for (std::size_t k_ = 0; k_ < values_.size(); ++k_)
+		values_[k_] = (double(k_) - 0x8000) * 31.415926535 / 7.0;
+
+	std::size_t sink_{};
+	auto ns_ = [&](auto && convert_) {
+		auto start_ = std::chrono::steady_clock::now();
+		for (double value_ : values_) sink_ += convert_(value_);
+		std::chrono::duration<double, std::nano> took_ = std::chrono::steady_clock::now() - start_;
+		return took_.count() / values_.size();
+	};
+
+	char buf_[0x200]{};
+	const double printf_f_ = ns_([&](double v_) { return std::snprintf(buf_, sizeof(buf_), "%f", v_); });
+	const double printf_g_ = ns_([&](double v_) { return std::snprintf(buf_, sizeof(buf_), "%.17g", v_); });
+	const double fixed_ = ns_([&](double v_) { return float_to_chars(v_, 6).size; });
+	const double shortest_ = ns_([&](double v_) { return float_to_chars(v_).size; });
+
+	print("\n\nfloat to chars, ns per value"
+		"\n\tprintf %%f: %f\n\tprintf %%.17g: %f\n\tfixed 6: %f\n\tshortest round trip: %f\n",
+		printf_f_, printf_g_, fixed_, shortest_);
+	DBJ_TEST_ATOM(sink_ > 0);
+}
+#endif // dbj_benchmarks
+
 DBJ_TEST_UNIT(core_utils)
 {
 	using namespace ::dbj::buf;
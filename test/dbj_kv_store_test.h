@@ -2,8 +2,13 @@
 
 // #include "../dbj_key_value_store.h"
 
+#include <algorithm>
+#include <fstream>
 #include <future>
 #include <random>
+#include <chrono>
+#include <thread>
+#include <vector>
 
 DBJ_TEST_SPACE_OPEN(kv_storage_test)
 
@@ -13,7 +18,7 @@ inline dbj::sync::guardian<KVS> guarded_kvs_;
 
 // https://en.cppreference.com/w/cpp/numeric/random/uniform_int_distribution
 inline const int random_int ( int max_ ) {
-	dbj::sync::lock_unlock __dbj_auto_lock__;
+	DBJ_SITE_LOCK;
 	std::random_device rd;  //Will be used to obtain a seed for the random number engine
 	std::mt19937 gen(rd()); //Standard mersenne_twister_engine seeded with rd()
 	std::uniform_int_distribution<> dis(1 ,max_);
@@ -22,16 +27,17 @@ inline const int random_int ( int max_ ) {
 
 inline size_t producer_( ) 
 {
-	dbj::sync::lock_unlock __dbj_auto_lock__;
 	static const std::string key_base_ = "K";
-	KVS & kvs = guarded_kvs_.load();
 	const int next_bunch_size = random_int(64);
-	for  ( int j = 0; j < next_bunch_size; j++)
-	{
-		kvs.add( 
-			key_base_ + std::to_string(j), j
-		);
-	}
+	// the guardian gives the kvs to one writer at the time
+	guarded_kvs_.update([&](KVS & kvs) {
+		for (int j = 0; j < next_bunch_size; j++)
+		{
+			kvs.add(
+				key_base_ + std::to_string(j), j
+			);
+		}
+	});
 	return next_bunch_size;
 }
 
@@ -43,10 +49,372 @@ DBJ_TEST_UNIT( dbj_kv_storage_test ) {
 	size_t r1 = DBJ_TEST_ATOM( handle_1.get() );
 	size_t r2 = DBJ_TEST_ATOM( handle_2.get() );
 
-	const KVS & kvs = guarded_kvs_.load();
+	// the copy, not the reference
+	const KVS kvs = guarded_kvs_.load();
 	bool DBJ_MAYBE(should_be_true) = (r1 + r2) == kvs.size();
 	KVS::value_vector r3 = DBJ_TEST_ATOM( kvs.retrieve("K"));
 	bool DBJ_MAYBE(should_be_true_too) = (r1 + r2) == r3.size();
 }
 
+DBJ_TEST_UNIT(dbj_sync_guardian)
+{
+	using ::dbj::sync::guardian;
+	using kind = ::dbj::sync::inner::guardian_kind;
+
+	// all four are always equal, a torn read would show
+	struct quad final { long long a, b, c, d; };
+
+	static_assert(guardian<int>::kind == kind::atomic);
+	static_assert(guardian<quad>::kind == kind::seqlock);
+	static_assert(guardian<std::string>::kind == kind::locked);
+
+	guardian<quad> guarded_quad_;
+	std::atomic<bool> done_{ false };
+	std::atomic<long> torn_{ 0 };
+
+	auto reader_ = [&] {
+		while (!done_.load()) {
+			const quad q_ = guarded_quad_.load();
+			if (q_.a != q_.b || q_.b != q_.c || q_.c != q_.d) ++torn_;
+		}
+	};
+	auto r1 = std::async(std::launch::async, reader_);
+	auto r2 = std::async(std::launch::async, reader_);
+	for (long long k = 1; k < 0xFFFF; ++k) {
+		guarded_quad_.update([](quad & q_) { ++q_.a; ++q_.b; ++q_.c; ++q_.d; });
+	}
+	done_ = true;
+	r1.get(); r2.get();
+
+	DBJ_TEST_ATOM(torn_.load() == 0);
+	DBJ_TEST_ATOM(guarded_quad_.load().d);
+
+	guardian<bool> signal_;
+	DBJ_TEST_ATOM(signal_.load());
+	DBJ_TEST_ATOM(signal_.store(true));
+}
+
+DBJ_TEST_UNIT(dbj_kv_storage_snapshot)
+{
+	::dbj::storage::snapshot_storage<int, std::string> dict_;
+	auto empty_ = dict_.load();
+
+	auto batch_ = dict_.make_batch();
+	batch_.add("alpha", 1).add("alpine", 2).add("beta", 3);
+	DBJ_TEST_ATOM(dict_.publish(std::move(batch_)));
+
+	// readers never wait, each sees one whole version
+	std::atomic<bool> done_{ false };
+	std::atomic<long> torn_{ 0 };
+	auto reader_ = std::async(std::launch::async, [&] {
+		while (!done_) {
+			auto snap_ = dict_.load();
+			if (snap_.size() != 3 + (snap_.version() - 1) * 0xF) ++torn_;
+		}
+	});
+	for (int version_ = 0; version_ < 0xFF; ++version_) {
+		auto next_ = dict_.make_batch();
+		for (int k = 0; k < 0xF; ++k) next_.add("K" + std::to_string(version_ * 0xF + k), k);
+		dict_.publish(std::move(next_));
+	}
+	done_ = true;
+	reader_.get();
+
+	DBJ_TEST_ATOM(torn_.load() == 0);
+	DBJ_TEST_ATOM(empty_.size() == 0);
+	DBJ_TEST_ATOM(dict_.load().version());
+	DBJ_TEST_ATOM(dict_.load().retrieve("alp"));
+}
+
+DBJ_TEST_UNIT(dbj_sync_locks)
+{
+	using namespace ::dbj::sync;
+	constexpr int threads_ = 4, rounds_ = 0xFFFF;
+
+	adaptive_lock<lock_stats> adaptive_;
+	rw_lock<lock_stats> rw_;
+	long count_{}, seen_{};
+
+	auto worker_ = [&] {
+		for (int k = 0; k < rounds_; ++k) {
+			{ std::lock_guard<decltype(adaptive_)> guard_(adaptive_); ++count_; }
+			if (0 == (k % 0x400)) {
+				std::lock_guard<decltype(rw_)> writer_(rw_); ++seen_;
+			}
+			else {
+				std::shared_lock<decltype(rw_)> reader_(rw_); _ASSERTE(seen_ >= 0);
+			}
+		}
+	};
+
+	std::vector<std::future<void>> handles_;
+	for (int t = 0; t < threads_; ++t)
+		handles_.push_back(std::async(std::launch::async, worker_));
+	for (auto & handle_ : handles_) handle_.get();
+
+	DBJ_TEST_ATOM(count_ == threads_ * rounds_);
+	DBJ_TEST_ATOM(adaptive_.stats().acquisitions.load());
+	DBJ_TEST_ATOM(adaptive_.stats().contended.load());
+	DBJ_TEST_ATOM(adaptive_.stats().wait_ns.load());
+	DBJ_TEST_ATOM(rw_.stats().contended.load());
+
+	// each site has its own mutex, the two sites sharing
+	// the data exclude each other through the one named lock
+	site_lock shared_lock_{ __FILE__, __LINE__ };
+	long shared_{}, own_{};
+	auto getter_ = [&] { DBJ_NAMED_LOCK(shared_lock_); return shared_; };
+	auto setter_ = [&] { DBJ_NAMED_LOCK(shared_lock_); ++shared_; };
+	auto own_site_ = [&] { DBJ_SITE_LOCK; ++own_; };
+	auto all_ = [&] {
+		for (int k = 0; k < rounds_; ++k) { setter_(); (void)getter_(); own_site_(); }
+	};
+	handles_.clear();
+	for (int t = 0; t < threads_; ++t)
+		handles_.push_back(std::async(std::launch::async, all_));
+	for (auto & handle_ : handles_) handle_.get();
+	_ASSERTE(getter_() == long(threads_) * rounds_);
+	_ASSERTE(own_ == long(threads_) * rounds_);
+
+	for_each_site([](site_lock const & site_) {
+		DBJ_TEST_ATOM(site_.line);
+		DBJ_TEST_ATOM(site_.stats().enabled);
+	});
+}
+
+
+DBJ_TEST_UNIT(dbj_kv_storage_flat_index)
+{
+	using flat_kvs = ::dbj::storage::keyvalue_storage<int, std::string, ::dbj::storage::backend::flat>;
+
+	flat_kvs flat_;
+	flat_.add("alpine", 2); flat_.add("alpha", 1); flat_.add("beta", 3); flat_.add("alpha", 4);
+	DBJ_TEST_ATOM(flat_.retrieve("alp").size() == 3);
+	DBJ_TEST_ATOM(flat_.retrieve("alpha", false).back() == 4);
+	DBJ_TEST_ATOM(flat_.retrieve("gamma").empty());
+
+	// the unsorted tail, before and after the merge, gives what the multimap gives
+	KVS tree_;
+	std::mt19937 random_{ 42 };
+	for (int k = 0; k < 0x2000; ++k) {
+		const std::string key_ = "K" + std::to_string(random_() % 0x400);
+		tree_.add(key_, k); flat_.add(key_, k);
+		if (0 == (k % 0x3FF)) {
+			_ASSERTE(flat_.retrieve("K1") == tree_.retrieve("K1"));
+			_ASSERTE(flat_.retrieve("K42", false) == tree_.retrieve("K42", false));
+		}
+	}
+	DBJ_TEST_ATOM(flat_.retrieve("K") == tree_.retrieve("K"));
+}
+
+DBJ_TEST_UNIT(dbj_kv_storage_art)
+{
+	using art_kvs = ::dbj::storage::keyvalue_storage<int, std::string, ::dbj::storage::backend::art>;
+
+	art_kvs art_;
+	art_.add("alpine", 2); art_.add("alpha", 1); art_.add("alp", 0); art_.add("alpha", 4);
+	DBJ_TEST_ATOM(art_.retrieve("alp").size() == 4);
+	DBJ_TEST_ATOM(art_.retrieve("alpha", false).back() == 4);
+	DBJ_TEST_ATOM(art_.retrieve("al", false).empty());
+}
+
+DBJ_TEST_UNIT(dbj_kv_storage_visit)
+{
+	KVS kvs_;
+	for (int k = 0; k < 100; ++k) kvs_.add("K" + std::to_string(k), k);
+
+	// references in the keys order, at most three
+	std::string keys_{};
+	DBJ_TEST_ATOM(kvs_.visit(std::string_view("K5"), [&](auto key_, int const &) { keys_.append(key_).append(";"); }, true, 3));
+	DBJ_TEST_ATOM(keys_);
+	// false from the callback stops the visit
+	DBJ_TEST_ATOM(kvs_.visit("K", [](auto, int const &) { return false; }));
+	DBJ_TEST_ATOM(kvs_.retrieve("K", true, 10).size() == 10);
+}
+
+DBJ_TEST_UNIT(dbj_kv_storage_bulk_load)
+{
+	KVS kvs_;
+	kvs_.add("beta", 0);
+	kvs_.bulk_load(std::vector< std::pair<std::string, int> >{ { "beta", 1 }, { "alpha", 2 }, { "beta", 3 } });
+	// equal keys keep the order of adding
+	DBJ_TEST_ATOM(kvs_.retrieve("beta", false) == (std::vector<int>{ 0, 1, 3 }));
+
+	KVS other_;
+	other_.add("alpine", 4);
+	kvs_.merge(other_);
+	DBJ_TEST_ATOM(kvs_.retrieve("alp") == (std::vector<int>{ 2, 4 }));
+
+	// the small batch is inserted, not merged, the order is the same
+	for (int k = 0; k < 0x40; ++k) kvs_.add("gamma" + std::to_string(k), k);
+	kvs_.bulk_load(std::vector< std::pair<std::string, int> >{ { "beta", 5 } });
+	DBJ_TEST_ATOM(kvs_.retrieve("beta", false) == (std::vector<int>{ 0, 1, 3, 5 }));
+
+	// all the backends load the same
+	const std::vector< std::pair<std::string, int> > pairs_{ { "beta", 1 }, { "alpine", 4 }, { "alpha", 2 }, { "beta", 3 } };
+	::dbj::storage::keyvalue_storage<int, std::string, ::dbj::storage::backend::flat> flat_;
+	::dbj::storage::keyvalue_storage<int, std::string, ::dbj::storage::backend::art> art_;
+	flat_.bulk_load(pairs_);
+	art_.bulk_load(pairs_);
+	DBJ_TEST_ATOM(flat_.retrieve("alp") == (std::vector<int>{ 2, 4 }));
+	DBJ_TEST_ATOM(art_.retrieve("beta", false) == (std::vector<int>{ 1, 3 }));
+}
+
+#ifdef dbj_benchmarks
+/*
+the benchmarks, opt in, see dbj++tests.h
+*/
+using kv_clock = std::chrono::steady_clock;
+
+inline double kv_ms_since(kv_clock::time_point start_)
+{
+	return std::chrono::duration<double, std::milli>(kv_clock::now() - start_).count();
+}
+
+/*
+threads from 1 to the number of cores
+add() only, and 1000 retrieve() for each add()
+keyvalue_storage is shared only if _DBJ_MT_ is defined
+*/
+template<typename STORE>
+inline double kv_ns_per_op(STORE & store_, unsigned threads_, unsigned reads_per_add_)
+{
+	constexpr unsigned ops_ = 0x40000;
+	auto start_ = kv_clock::now();
+	std::vector<std::future<void>> handles_;
+	for (unsigned t = 0; t < threads_; ++t)
+		handles_.push_back(std::async(std::launch::async, [&, t] {
+		for (unsigned k = 0; k < ops_ / threads_; ++k) {
+			if (reads_per_add_ == 0 || (k % reads_per_add_) == 0)
+				store_.add("K" + std::to_string(t * ops_ + k), int(k));
+			else
+				(void)store_.retrieve("K1", false);
+		}
+	}));
+	for (auto & handle_ : handles_) handle_.get();
+	return kv_ms_since(start_) * 1e6 / ops_;
+}
+
+DBJ_TEST_UNIT(dbj_kv_storage_scaling)
+{
+	using sharded = ::dbj::storage::sharded_storage<int, std::string>;
+	const unsigned cores_ = (std::max)(1U, std::thread::hardware_concurrency());
+
+	for (unsigned threads_ = 1; threads_ <= cores_; threads_ *= 2)
+	{
+		sharded add_only_, read_mostly_;
+		::dbj::fmt::print("\n%2u threads, ns/op, sharded add %8.1f, read mostly %8.1f",
+			threads_, kv_ns_per_op(add_only_, threads_, 0), kv_ns_per_op(read_mostly_, threads_, 1000));
+#ifdef _DBJ_MT_
+		KVS kvs_add_only_, kvs_read_mostly_;
+		::dbj::fmt::print(" | keyvalue_storage add %8.1f, read mostly %8.1f",
+			kv_ns_per_op(kvs_add_only_, threads_, 0), kv_ns_per_op(kvs_read_mostly_, threads_, 1000));
+#endif
+	}
+}
+
+/*
+dict_en/words.zip holds words.txt, 370k+ english words
+unzip it next to the zip, the benchmarks are skipped if it is not there
+*/
+inline std::vector<std::string> kv_dictionary_words()
+{
+	std::vector<std::string> words_{};
+	for (const char * path_ : { "dict_en/words.txt", "../dict_en/words.txt", "../../dict_en/words.txt" })
+	{
+		std::ifstream file_(path_);
+		if (!file_) continue;
+		for (std::string word_; std::getline(file_, word_); )
+		{
+			if (!word_.empty() && word_.back() == '\r') word_.pop_back();
+			if (!word_.empty()) words_.push_back(word_);
+		}
+		break;
+	}
+	return words_;
+}
+
+struct kv_found final {
+	std::size_t prefixed{};
+	std::size_t exact{};
+	std::size_t top{};
+};
+
+/*
+one backend, all the words
+add() one by one, bulk_load(), merge() of the two halves
+all the prefix queries, exact match of every 4th word, top 10 of the prefix queries
+*/
+template<typename BACKEND>
+inline kv_found kv_benchmark(
+	std::vector< std::pair<std::string, int> > const & pairs_,
+	std::vector< std::string > const & prefixes_,
+	const char * name_)
+{
+	using store_type = ::dbj::storage::keyvalue_storage<int, std::string, BACKEND>;
+
+	store_type one_by_one_, bulk_, merged_, half_;
+	auto start_ = kv_clock::now();
+	for (auto const & pair_ : pairs_) one_by_one_.add(pair_.first, pair_.second);
+	const double add_ = kv_ms_since(start_);
+
+	start_ = kv_clock::now();
+	bulk_.bulk_load(pairs_);
+	const double bulk_load_ = kv_ms_since(start_);
+
+	const auto middle_ = pairs_.begin() + pairs_.size() / 2;
+	merged_.bulk_load(std::vector< std::pair<std::string, int> >(pairs_.begin(), middle_));
+	half_.bulk_load(std::vector< std::pair<std::string, int> >(middle_, pairs_.end()));
+	start_ = kv_clock::now();
+	merged_.merge(half_);
+	const double merge_ = kv_ms_since(start_);
+
+	kv_found found_{};
+	start_ = kv_clock::now();
+	for (auto const & prefix_ : prefixes_) found_.prefixed += bulk_.retrieve(prefix_).size();
+	const double prefixed_ = kv_ms_since(start_);
+
+	start_ = kv_clock::now();
+	for (std::size_t k = 0; k < pairs_.size(); k += 4) found_.exact += bulk_.retrieve(pairs_[k].first, false).size();
+	const double exact_ = kv_ms_since(start_);
+
+	start_ = kv_clock::now();
+	for (auto const & prefix_ : prefixes_) found_.top += bulk_.visit(prefix_, [](auto, int const &) {}, true, 10);
+	const double top_ = kv_ms_since(start_);
+
+	::dbj::fmt::print("\n\t%-8s add %8.1f, bulk_load %8.1f, merge %8.1f, prefix %8.1f, exact %8.1f, top 10 %8.1f, bytes per key %6.1f",
+		name_, add_, bulk_load_, merge_, prefixed_, exact_, top_, double(bulk_.memory_used()) / pairs_.size());
+	_ASSERTE(bulk_.size() == one_by_one_.size() && merged_.size() == one_by_one_.size());
+	return found_;
+}
+
+DBJ_TEST_UNIT(dbj_kv_storage_benchmarks)
+{
+	const std::vector<std::string> words_ = kv_dictionary_words();
+	if (words_.empty()) {
+		::dbj::fmt::print("\ndict_en/words.txt not found, kv storage benchmarks skipped");
+		return;
+	}
+
+	// the words are shuffled, the file is almost sorted
+	std::vector< std::pair<std::string, int> > pairs_{};
+	pairs_.reserve(words_.size());
+	for (auto const & word_ : words_) pairs_.emplace_back(word_, int(pairs_.size()));
+	std::shuffle(pairs_.begin(), pairs_.end(), std::mt19937{ 42 });
+
+	// two letter prefixes of every 64th word
+	std::vector<std::string> prefixes_{};
+	for (std::size_t k = 0; k < words_.size(); k += 64)
+		prefixes_.push_back(words_[k].substr(0, 2));
+
+	::dbj::fmt::print("\n%zu words, %zu prefixes, ms", pairs_.size(), prefixes_.size());
+	const kv_found tree_ = kv_benchmark<::dbj::storage::backend::multimap>(pairs_, prefixes_, "multimap");
+	const kv_found flat_ = kv_benchmark<::dbj::storage::backend::flat>(pairs_, prefixes_, "flat");
+	const kv_found art_ = kv_benchmark<::dbj::storage::backend::art>(pairs_, prefixes_, "art");
+
+	DBJ_TEST_ATOM(tree_.prefixed == flat_.prefixed && tree_.prefixed == art_.prefixed);
+	DBJ_TEST_ATOM(tree_.exact == flat_.exact && tree_.exact == art_.exact);
+	DBJ_TEST_ATOM(tree_.top == flat_.top && tree_.top == art_.top);
+}
+#endif // dbj_benchmarks
+
 DBJ_TEST_SPACE_CLOSE
\ No newline at end of file
@@ -164,7 +164,8 @@ namespace dbj {
 					) const noexcept
 				{
 					// mt safe in any build
-					dbj::sync::lock_unlock auto_lock;
+					// the only site adding to the tuset
+					DBJ_SITE_LOCK;
 					return internal::append(tunit_, msg_.data());
 				}
 #ifdef _DEBUG
@@ -0,0 +1,558 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/*
+2019-04-11	dbj@dbj.org
+
+adaptive radix tree, after
+"The Adaptive Radix Tree: ARTful Indexing for Main-Memory Databases"
+Leis, Kemper, Neumann, ICDE 2013
+
+inner nodes hold 4, 16, 48 or 256 children and grow as they fill
+the path compression is hybrid: up to max_prefix bytes are held in the
+node, the rest is checked against the full key held in the leaf
+
+keys are walked as bytes, each char is split most significant byte first
+thus the order is the one of the unsigned chars, as in std::char_traits
+for char and for 16 bit wchar_t
+
+one key can "hold" multiple values, in the order of adding
+the key which is the prefix of other keys is held in the node where it ends
+
+not thread safe, use it through the keyvalue_storage
+*/
+namespace dbj::storage {
+
+	template <typename key_type, typename value_type >
+	class art_index final
+	{
+	public:
+		using	mapped_type = value_type;
+		using	char_type = typename key_type::value_type;
+		using	key_view = std::basic_string_view<char_type>;
+		using	value_vector = std::vector< value_type >;
+
+		constexpr static std::uint32_t max_prefix = 8;
+
+	private:
+		enum class kind : std::uint8_t { leaf, node4, node16, node48, node256 };
+
+		struct any_node {
+			kind node_kind;
+			explicit any_node(kind k_) noexcept : node_kind(k_) {}
+		};
+
+		// most keys have one value, it is not on the heap
+		struct leaf final : any_node {
+			key_type key;
+			value_type value;
+			value_vector more{};
+			leaf(key_view key_, value_type const & value_) : any_node(kind::leaf), key(key_), value(value_) {}
+		};
+
+		struct inner_node : any_node {
+			std::uint16_t count{};
+			std::uint32_t prefix_size{};
+			std::uint8_t prefix[max_prefix]{};
+			// the key ending in this node
+			leaf * here{};
+			explicit inner_node(kind k_) noexcept : any_node(k_) {}
+		};
+
+		// keys are sorted
+		struct node4 final : inner_node {
+			std::uint8_t keys[4]{};
+			any_node * children[4]{};
+			node4() noexcept : inner_node(kind::node4) {}
+		};
+
+		// keys are sorted
+		struct node16 final : inner_node {
+			std::uint8_t keys[16]{};
+			any_node * children[16]{};
+			node16() noexcept : inner_node(kind::node16) {}
+		};
+
+		// index holds the child slot + 1, 0 is empty
+		struct node48 final : inner_node {
+			std::uint8_t index[256]{};
+			any_node * children[48]{};
+			node48() noexcept : inner_node(kind::node48) {}
+		};
+
+		struct node256 final : inner_node {
+			any_node * children[256]{};
+			node256() noexcept : inner_node(kind::node256) {}
+		};
+
+#pragma region bytes of the key
+		constexpr static std::size_t char_bytes = sizeof(char_type);
+
+		static std::size_t bytes_size(key_view key_) noexcept {
+			return key_.size() * char_bytes;
+		}
+
+		static std::uint8_t byte_at(key_view key_, std::size_t pos_) noexcept {
+			using unsigned_char = std::make_unsigned_t<char_type>;
+			const auto char_ = static_cast<unsigned_char>(key_[pos_ / char_bytes]);
+			const std::size_t shift_ = (char_bytes - 1 - pos_ % char_bytes) * 8;
+			return static_cast<std::uint8_t>(char_ >> shift_);
+		}
+
+		// bytes are the same from the depth_ onwards, at most max_ of them
+		static std::size_t common_bytes(key_view left_, key_view right_, std::size_t depth_, std::size_t max_) noexcept {
+			const std::size_t end_ = (std::min)({ bytes_size(left_), bytes_size(right_), depth_ + max_ });
+			std::size_t pos_ = depth_;
+			while (pos_ < end_ && byte_at(left_, pos_) == byte_at(right_, pos_)) ++pos_;
+			return pos_ - depth_;
+		}
+
+		static bool starts_with(key_view key_, key_view prefix_) noexcept {
+			return key_.size() >= prefix_.size() && key_.compare(0, prefix_.size(), prefix_) == 0;
+		}
+#pragma endregion
+
+#pragma region children
+		static any_node ** find_child(inner_node * node_, std::uint8_t byte_) noexcept
+		{
+			switch (node_->node_kind) {
+			case kind::node4: {
+				auto n_ = static_cast<node4 *>(node_);
+				for (unsigned k = 0; k < n_->count; ++k)
+					if (n_->keys[k] == byte_) return &n_->children[k];
+				return nullptr;
+			}
+			case kind::node16: {
+				auto n_ = static_cast<node16 *>(node_);
+				auto end_ = n_->keys + n_->count;
+				auto pos_ = std::lower_bound(n_->keys, end_, byte_);
+				return (pos_ != end_ && *pos_ == byte_) ? &n_->children[pos_ - n_->keys] : nullptr;
+			}
+			case kind::node48: {
+				auto n_ = static_cast<node48 *>(node_);
+				return n_->index[byte_] ? &n_->children[n_->index[byte_] - 1] : nullptr;
+			}
+			case kind::node256: {
+				auto n_ = static_cast<node256 *>(node_);
+				return n_->children[byte_] ? &n_->children[byte_] : nullptr;
+			}
+			default:
+				_ASSERTE(false);
+				return nullptr;
+			}
+		}
+
+		// keeps the keys sorted
+		template<typename NODE>
+		static void insert_sorted(NODE * node_, std::uint8_t byte_, any_node * child_) noexcept
+		{
+			unsigned pos_ = 0;
+			while (pos_ < node_->count && node_->keys[pos_] < byte_) ++pos_;
+			std::memmove(node_->keys + pos_ + 1, node_->keys + pos_, node_->count - pos_);
+			std::memmove(node_->children + pos_ + 1, node_->children + pos_, (node_->count - pos_) * sizeof(any_node *));
+			node_->keys[pos_] = byte_;
+			node_->children[pos_] = child_;
+			++node_->count;
+		}
+
+		static void copy_header(inner_node * to_, inner_node const * from_) noexcept
+		{
+			to_->count = from_->count;
+			to_->prefix_size = from_->prefix_size;
+			std::memcpy(to_->prefix, from_->prefix, max_prefix);
+			to_->here = from_->here;
+		}
+
+		// the node is replaced with the larger one when full
+		static void add_child(any_node *& ref_, std::uint8_t byte_, any_node * child_)
+		{
+			inner_node * node_ = static_cast<inner_node *>(ref_);
+			switch (node_->node_kind) {
+			case kind::node4: {
+				auto n_ = static_cast<node4 *>(node_);
+				if (n_->count < 4) { insert_sorted(n_, byte_, child_); return; }
+				auto bigger_ = new node16{};
+				copy_header(bigger_, n_);
+				std::copy(n_->keys, n_->keys + 4, bigger_->keys);
+				std::copy(n_->children, n_->children + 4, bigger_->children);
+				delete n_;
+				ref_ = bigger_;
+				insert_sorted(bigger_, byte_, child_);
+				return;
+			}
+			case kind::node16: {
+				auto n_ = static_cast<node16 *>(node_);
+				if (n_->count < 16) { insert_sorted(n_, byte_, child_); return; }
+				auto bigger_ = new node48{};
+				copy_header(bigger_, n_);
+				for (unsigned k = 0; k < 16; ++k) {
+					bigger_->children[k] = n_->children[k];
+					bigger_->index[n_->keys[k]] = std::uint8_t(k + 1);
+				}
+				delete n_;
+				ref_ = bigger_;
+				add_child(ref_, byte_, child_);
+				return;
+			}
+			case kind::node48: {
+				auto n_ = static_cast<node48 *>(node_);
+				if (n_->count < 48) {
+					n_->children[n_->count] = child_;
+					n_->index[byte_] = std::uint8_t(++n_->count);
+					return;
+				}
+				auto bigger_ = new node256{};
+				copy_header(bigger_, n_);
+				for (unsigned b = 0; b < 256; ++b)
+					if (n_->index[b]) bigger_->children[b] = n_->children[n_->index[b] - 1];
+				delete n_;
+				ref_ = bigger_;
+				add_child(ref_, byte_, child_);
+				return;
+			}
+			case kind::node256: {
+				auto n_ = static_cast<node256 *>(node_);
+				n_->children[byte_] = child_;
+				++n_->count;
+				return;
+			}
+			default:
+				_ASSERTE(false);
+			}
+		}
+
+		/// callback is bool (any_node *), false stops, children are in the order of their bytes
+		template<typename F>
+		static bool for_each_child(inner_node const * node_, F && callback_)
+		{
+			switch (node_->node_kind) {
+			case kind::node4: {
+				auto n_ = static_cast<node4 const *>(node_);
+				for (unsigned k = 0; k < n_->count; ++k)
+					if (!callback_(n_->children[k])) return false;
+				return true;
+			}
+			case kind::node16: {
+				auto n_ = static_cast<node16 const *>(node_);
+				for (unsigned k = 0; k < n_->count; ++k)
+					if (!callback_(n_->children[k])) return false;
+				return true;
+			}
+			case kind::node48: {
+				auto n_ = static_cast<node48 const *>(node_);
+				for (unsigned b = 0; b < 256; ++b)
+					if (n_->index[b] && !callback_(n_->children[n_->index[b] - 1])) return false;
+				return true;
+			}
+			case kind::node256: {
+				auto n_ = static_cast<node256 const *>(node_);
+				for (unsigned b = 0; b < 256; ++b)
+					if (n_->children[b] && !callback_(n_->children[b])) return false;
+				return true;
+			}
+			default:
+				_ASSERTE(false);
+				return false;
+			}
+		}
+#pragma endregion
+
+#pragma region tree
+		// all the leaves bellow share the path to the node, thus any will do
+		static leaf const * minimum(any_node const * node_) noexcept
+		{
+			while (node_->node_kind != kind::leaf) {
+				auto inner_ = static_cast<inner_node const *>(node_);
+				if (inner_->here) return inner_->here;
+				any_node const * first_{};
+				for_each_child(inner_, [&](any_node const * child_) { first_ = child_; return false; });
+				node_ = first_;
+			}
+			return static_cast<leaf const *>(node_);
+		}
+
+		// the full prefix of the node is checked, the bytes not held are taken from the leaf
+		static std::size_t prefix_mismatch(inner_node const * node_, key_view key_, std::size_t depth_) noexcept
+		{
+			const std::size_t held_ = (std::min)(std::size_t(node_->prefix_size), std::size_t(max_prefix));
+			const std::size_t key_bytes_ = bytes_size(key_);
+			std::size_t k = 0;
+			for (; k < held_; ++k) {
+				if (depth_ + k >= key_bytes_ || node_->prefix[k] != byte_at(key_, depth_ + k)) return k;
+			}
+			if (node_->prefix_size > max_prefix) {
+				return k + common_bytes(minimum(node_)->key, key_, depth_ + k, node_->prefix_size - k);
+			}
+			return k;
+		}
+
+		static void set_prefix(inner_node * node_, key_view key_, std::size_t depth_, std::size_t size_) noexcept
+		{
+			node_->prefix_size = std::uint32_t(size_);
+			for (std::size_t k = 0; k < (std::min)(size_, std::size_t(max_prefix)); ++k)
+				node_->prefix[k] = byte_at(key_, depth_ + k);
+		}
+
+		void insert_(any_node *& ref_, key_view key_, value_type const & value_, std::size_t depth_)
+		{
+			const std::size_t key_bytes_ = bytes_size(key_);
+
+			if (ref_ == nullptr) {
+				ref_ = new leaf(key_, value_);
+				++size_;
+				return;
+			}
+
+			if (ref_->node_kind == kind::leaf) {
+				leaf * old_ = static_cast<leaf *>(ref_);
+				if (key_view(old_->key) == key_) {
+					old_->more.push_back(value_);
+					++size_;
+					return;
+				}
+				// two keys, the new node holds their common path
+				leaf * new_ = new leaf(key_, value_);
+				++size_;
+				auto node_ = new node4{};
+				const std::size_t common_ = common_bytes(old_->key, key_, depth_, std::size_t(-1) / 2);
+				set_prefix(node_, key_, depth_, common_);
+				const std::size_t split_ = depth_ + common_;
+				for (leaf * leaf_ : { old_, new_ }) {
+					if (bytes_size(leaf_->key) == split_) node_->here = leaf_;
+					else insert_sorted(node_, byte_at(leaf_->key, split_), leaf_);
+				}
+				ref_ = node_;
+				return;
+			}
+
+			inner_node * node_ = static_cast<inner_node *>(ref_);
+			if (node_->prefix_size > 0) {
+				const std::size_t mismatch_ = prefix_mismatch(node_, key_, depth_);
+				if (mismatch_ < node_->prefix_size) {
+					// the node goes one level down, under the common part of its prefix
+					leaf const * min_ = minimum(node_);
+					auto parent_ = new node4{};
+					set_prefix(parent_, min_->key, depth_, mismatch_);
+					const std::uint8_t node_byte_ = byte_at(min_->key, depth_ + mismatch_);
+					set_prefix(node_, min_->key, depth_ + mismatch_ + 1, node_->prefix_size - mismatch_ - 1);
+					insert_sorted(parent_, node_byte_, node_);
+
+					leaf * new_ = new leaf(key_, value_);
+					++size_;
+					if (key_bytes_ == depth_ + mismatch_) parent_->here = new_;
+					else insert_sorted(parent_, byte_at(key_, depth_ + mismatch_), new_);
+					ref_ = parent_;
+					return;
+				}
+				depth_ += node_->prefix_size;
+			}
+
+			if (depth_ == key_bytes_) {
+				if (node_->here) node_->here->more.push_back(value_);
+				else node_->here = new leaf(key_, value_);
+				++size_;
+				return;
+			}
+
+			const std::uint8_t byte_ = byte_at(key_, depth_);
+			if (any_node ** child_ = find_child(node_, byte_)) {
+				insert_(*child_, key_, value_, depth_ + 1);
+				return;
+			}
+			add_child(ref_, byte_, new leaf(key_, value_));
+			++size_;
+		}
+
+		// the key order, the key ending in the node goes first
+		template<typename F>
+		static bool walk_(any_node const * node_, F & callback_)
+		{
+			if (node_->node_kind == kind::leaf) {
+				leaf const * leaf_ = static_cast<leaf const *>(node_);
+				if (!callback_(key_view(leaf_->key), leaf_->value)) return false;
+				for (value_type const & value_ : leaf_->more)
+					if (!callback_(key_view(leaf_->key), value_)) return false;
+				return true;
+			}
+			auto inner_ = static_cast<inner_node const *>(node_);
+			if (inner_->here && !walk_(inner_->here, callback_)) return false;
+			return for_each_child(inner_, [&](any_node const * child_) { return walk_(child_, callback_); });
+		}
+
+		static void destroy_(any_node * node_) noexcept
+		{
+			if (node_ == nullptr) return;
+			switch (node_->node_kind) {
+			case kind::leaf: delete static_cast<leaf *>(node_); return;
+			default: {
+				auto inner_ = static_cast<inner_node *>(node_);
+				destroy_(inner_->here);
+				for_each_child(inner_, [](any_node * child_) { destroy_(child_); return true; });
+				switch (node_->node_kind) {
+				case kind::node4: delete static_cast<node4 *>(node_); return;
+				case kind::node16: delete static_cast<node16 *>(node_); return;
+				case kind::node48: delete static_cast<node48 *>(node_); return;
+				default: delete static_cast<node256 *>(node_); return;
+				}
+			}
+			}
+		}
+
+		static any_node * clone_(any_node const * node_)
+		{
+			if (node_ == nullptr) return nullptr;
+			auto clone_children_ = [](auto * to_) {
+				to_->here = static_cast<leaf *>(clone_(to_->here));
+				for (auto & child_ : to_->children) child_ = clone_(child_);
+				return to_;
+			};
+			switch (node_->node_kind) {
+			case kind::leaf: return new leaf(*static_cast<leaf const *>(node_));
+			case kind::node4: return clone_children_(new node4(*static_cast<node4 const *>(node_)));
+			case kind::node16: return clone_children_(new node16(*static_cast<node16 const *>(node_)));
+			case kind::node48: return clone_children_(new node48(*static_cast<node48 const *>(node_)));
+			default: return clone_children_(new node256(*static_cast<node256 const *>(node_)));
+			}
+		}
+
+		static std::size_t memory_(any_node const * node_) noexcept
+		{
+			if (node_ == nullptr) return 0;
+			switch (node_->node_kind) {
+			case kind::leaf: {
+				leaf const * leaf_ = static_cast<leaf const *>(node_);
+				const std::size_t key_heap_ = (leaf_->key.capacity() > key_type{}.capacity())
+					? (leaf_->key.capacity() + 1) * sizeof(char_type) : 0;
+				return sizeof(leaf) + key_heap_ + leaf_->more.capacity() * sizeof(value_type);
+			}
+			default: {
+				auto inner_ = static_cast<inner_node const *>(node_);
+				std::size_t size_ = memory_(inner_->here);
+				for_each_child(inner_, [&](any_node const * child_) { size_ += memory_(child_); return true; });
+				switch (node_->node_kind) {
+				case kind::node4: return size_ + sizeof(node4);
+				case kind::node16: return size_ + sizeof(node16);
+				case kind::node48: return size_ + sizeof(node48);
+				default: return size_ + sizeof(node256);
+				}
+			}
+			}
+		}
+#pragma endregion
+
+		any_node * root_{};
+		std::size_t size_{};
+
+	public:
+		art_index() = default;
+		~art_index() { destroy_(root_); }
+
+		art_index(const art_index & other_) : root_(clone_(other_.root_)), size_(other_.size_) {}
+		art_index & operator = (const art_index & other_) {
+			if (&other_ != this) { art_index copy_(other_); swap(copy_); }
+			return *this;
+		}
+
+		art_index(art_index && other_) noexcept { swap(other_); }
+		art_index & operator = (art_index && other_) noexcept {
+			art_index gone_(std::move(other_));
+			swap(gone_);
+			return *this;
+		}
+
+		void swap(art_index & other_) noexcept {
+			std::swap(root_, other_.root_);
+			std::swap(size_, other_.size_);
+		}
+
+		/// the number of the values, as in std::multimap
+		const size_t size() const noexcept { return size_; }
+		const bool empty() const noexcept { return size_ < 1; }
+
+		void clear() noexcept {
+			destroy_(root_);
+			root_ = nullptr;
+			size_ = 0;
+		}
+
+		/// equal keys are added after the existing ones
+		void insert(std::pair<key_type, value_type> const & pair_)
+		{
+			_ASSERTE(false == pair_.first.empty());
+			insert_(root_, pair_.first, pair_.second, 0);
+		}
+
+		/// <summary>
+		/// visit the values of the key, in the order of adding
+		/// callback is as for the walk_prefix()
+		/// prefixes are skipped on the way down, the leaf has the full key
+		/// returns false if stopped by the callback
+		/// </summary>
+		template<typename F>
+		bool walk_exact(key_view key_, F callback_) const
+		{
+			leaf const * leaf_ = find_(key_);
+			return leaf_ ? walk_(leaf_, callback_) : true;
+		}
+
+	private:
+		leaf const * find_(key_view key_) const noexcept
+		{
+			const std::size_t key_bytes_ = bytes_size(key_);
+			any_node const * node_ = root_;
+			std::size_t depth_ = 0;
+			while (node_ && node_->node_kind != kind::leaf) {
+				auto inner_ = static_cast<inner_node const *>(node_);
+				depth_ += inner_->prefix_size;
+				if (depth_ > key_bytes_) return nullptr;
+				if (depth_ == key_bytes_) { node_ = inner_->here; break; }
+				any_node * const * child_ = find_child(const_cast<inner_node *>(inner_), byte_at(key_, depth_));
+				if (!child_) return nullptr;
+				node_ = *child_;
+				++depth_;
+			}
+			if (node_ == nullptr) return nullptr;
+			leaf const * leaf_ = static_cast<leaf const *>(node_);
+			return key_view(leaf_->key) == key_ ? leaf_ : nullptr;
+		}
+
+	public:
+
+		/// <summary>
+		/// visit the keys starting with the prefix, in the keys order
+		/// callback is bool (key_view, value_type const &), false stops the walk
+		/// the empty prefix visits all
+		/// returns false if stopped by the callback
+		/// </summary>
+		template<typename F>
+		bool walk_prefix(key_view prefix_, F callback_) const
+		{
+			const std::size_t prefix_bytes_ = bytes_size(prefix_);
+			any_node const * node_ = root_;
+			std::size_t depth_ = 0;
+			while (node_ && node_->node_kind != kind::leaf) {
+				auto inner_ = static_cast<inner_node const *>(node_);
+				if (depth_ + inner_->prefix_size >= prefix_bytes_) break;
+				depth_ += inner_->prefix_size;
+				any_node * const * child_ = find_child(const_cast<inner_node *>(inner_), byte_at(prefix_, depth_));
+				if (!child_) return true;
+				node_ = *child_;
+				++depth_;
+			}
+			if (node_ == nullptr) return true;
+			// the skipped bytes are checked once, against any leaf bellow
+			if (!starts_with(minimum(node_)->key, prefix_)) return true;
+			return walk_(node_, callback_);
+		}
+
+		/// all the nodes and leaves, and the heap of the keys and values
+		std::size_t memory_used() const noexcept { return memory_(root_); }
+	}; // eof art_index
+
+} // dbj::storage
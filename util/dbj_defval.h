@@ -74,8 +74,8 @@ namespace dbj {
 		const volatile T & operator ()
 			(const T & new_) const volatile noexcept
 		{
-			// safe in MT situations
-			DBJ_AUTO_LOCK;
+			// safe in MT situations, one setter site per T
+			DBJ_SITE_LOCK;
 			if (new_ != default_value_)
 				default_value_ = new_;
 			return default_value_;
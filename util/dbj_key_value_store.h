@@ -1,7 +1,33 @@
 #pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string_view>
+#include <vector>
 #include "../core/dbj_synchro.h"
 #include "dbj_string_util.h"
+#include "dbj_art_index.h"
+
+#if __has_include(<version>)
+#include <version>
+#endif
+
+// C++20
+#if defined(__cpp_lib_atomic_shared_ptr) && (__cpp_lib_atomic_shared_ptr >= 201711L)
+#define DBJ_KVS_ATOMIC_SHARED_PTR
+#endif
+
+// C++17, not in every std lib, on g++ it needs TBB
+#if defined(__cpp_lib_execution) && (__cpp_lib_execution >= 201603L) && __has_include(<execution>)
+#include <execution>
+#define DBJ_KVS_PARALLEL_SORT
+#endif
 
 #if _HAS_CXX17
 #else
@@ -17,11 +43,547 @@ namespace dbj::storage {
 
 	using namespace std;
 
-	template <typename value_type, typename key_type = std::wstring >
+	namespace inner {
+		/*
+		visitors over the storages, shared by the storages bellow, callers do the locking
+		the callback is bool (key_view, value_type const &), false stops the visit
+		visitors return false if stopped
+		keys are compared to the views, the std::multimap has to be std::less<> ordered
+		*/
+		template<typename storage_type, typename char_type, typename F>
+		bool visit_exact(const storage_type & key_value_storage_, std::basic_string_view<char_type> query, F && callback_)
+		{
+			auto range = key_value_storage_.equal_range(query);
+			for (auto walker_ = range.first; walker_ != range.second; ++walker_)
+				if (!callback_(std::basic_string_view<char_type>(walker_->first), walker_->second)) return false;
+			return true;
+		}
+
+		template<typename storage_type, typename char_type, typename F>
+		bool visit_prefix(const storage_type & key_value_storage_, std::basic_string_view<char_type> prefix_, F && callback_)
+		{
+			// the first key not less than the prefix, it might be the prefix itself
+			for (auto walker_ = key_value_storage_.lower_bound(prefix_);
+				walker_ != key_value_storage_.end(); ++walker_)
+			{
+				const std::basic_string_view<char_type> walker_key(walker_->first);
+				if (walker_key.substr(0, prefix_.size()) != prefix_) break;
+				if (!callback_(walker_key, walker_->second)) return false;
+			}
+			return true;
+		}
+
+		/// the callback gets the storage_type::value_type
+		template<typename storage_type, typename F>
+		F for_each_element(const storage_type & key_value_storage_, F callback_)
+		{
+			return std::for_each(key_value_storage_.begin(), key_value_storage_.end(), callback_);
+		}
+
+		/// <summary>
+		/// estimated, the nodes and the heap of the keys
+		/// std::multimap node is three pointers and the colour, then the pair
+		/// </summary>
+		template<typename storage_type>
+		std::size_t memory_used(const storage_type & key_value_storage_) noexcept
+		{
+			using key_type = typename storage_type::key_type;
+			constexpr std::size_t node_size_ = 4 * sizeof(void *) + sizeof(typename storage_type::value_type);
+			const std::size_t sso_ = key_type{}.capacity();
+			std::size_t size_ = key_value_storage_.size() * node_size_;
+			for (auto const & pair_ : key_value_storage_)
+				if (pair_.first.capacity() > sso_)
+					size_ += (pair_.first.capacity() + 1) * sizeof(typename key_type::value_type);
+			return size_;
+		}
+
+		/*
+		2019-04-13	dbj@dbj.org
+		bulk loading, the pairs are sorted once, by the key only
+		equal keys keep their order, as if added one by one
+		bigger loads are sorted in parallel, where the std lib can
+		*/
+		constexpr inline std::size_t bulk_parallel_min = 0x10000;
+
+		template<typename pair_vector>
+		void sort_pairs(pair_vector & pairs_)
+		{
+			auto by_key_ = [](auto const & left_, auto const & right_) { return left_.first < right_.first; };
+#ifdef DBJ_KVS_PARALLEL_SORT
+			if (pairs_.size() >= bulk_parallel_min) {
+				std::stable_sort(std::execution::par, pairs_.begin(), pairs_.end(), by_key_);
+				return;
+			}
+#endif
+			std::stable_sort(pairs_.begin(), pairs_.end(), by_key_);
+		}
+
+		/// a batch this many times smaller than the storage is
+		/// inserted, not merged, O(M log N) beats O(N + M) there
+		constexpr inline std::size_t bulk_rebuild_ratio = 0x10;
+
+		/// <summary>
+		/// the sorted pairs are merged in
+		/// first the new nodes are made, aside, if that throws
+		/// the storage is not touched, after that only the nodes
+		/// are moved, nothing is allocated
+		/// a small batch goes in node by node, O(M log N),
+		/// a big one is merged with the storage into a new tree, O(N + M)
+		/// where the hint at the back makes each insert amortized O(1)
+		/// equal keys, the ones already in the storage go first
+		/// </summary>
+		template<typename storage_type, typename pair_vector>
+		void merge_sorted(storage_type & key_value_storage_, pair_vector && sorted_)
+		{
+			storage_type incoming_{};
+			for (auto & pair_ : sorted_)
+				incoming_.emplace_hint(incoming_.end(), std::move(pair_.first), std::move(pair_.second));
+
+			if (incoming_.size() * bulk_rebuild_ratio < key_value_storage_.size()) {
+				// each at the upper bound of its key
+				key_value_storage_.merge(incoming_);
+				return;
+			}
+
+			storage_type merged_{};
+			while (!key_value_storage_.empty() || !incoming_.empty())
+			{
+				if (incoming_.empty() ||
+					(!key_value_storage_.empty() && !(incoming_.begin()->first < key_value_storage_.begin()->first)))
+				{
+					merged_.insert(merged_.end(), key_value_storage_.extract(key_value_storage_.begin()));
+				}
+				else {
+					merged_.insert(merged_.end(), incoming_.extract(incoming_.begin()));
+				}
+			}
+			key_value_storage_.swap(merged_);
+		}
+
+		/// does the storage need the pairs sorted before the merge_sorted()
+		template<typename storage_type>
+		struct bulk_needs_sort : std::true_type {};
+
+		// the iterator of the storage, if it has one
+		template<typename storage_type, typename = void >
+		struct iterator_of { using type = void; };
+
+		template<typename storage_type >
+		struct iterator_of<storage_type, std::void_t<typename storage_type::iterator> > {
+			using type = typename storage_type::iterator;
+		};
+	} // inner
+
+	/// <summary>
+	/// 2019-04-10	dbj@dbj.org
+	/// sorted, contiguous, read mostly
+	/// all the keys are in one string pool, one after the other
+	/// entries are { key offset, key size, value }, sorted by the key
+	/// prefix lookup is one binary search and then linear scan
+	/// over the neighbouring entries, no tree nodes to chase
+	/// adds go to the short unsorted tail, the add which grows it beyond
+	/// tail_max sorts it and merges it into the sorted run, the run is
+	/// merged into the body once it outgrows 1/8 of the body
+	/// thus the ordering is all done by the adds, the body merge is O(N)
+	/// once per N/8 adds, the run merge is O(N/8) once per tail_max adds
+	/// reads binary search the body and the run, and scan the tail,
+	/// they change nothing
+	/// equal keys keep the order of adding, as in the multimap
+	/// walks can be made from many threads, the writes can not
+	/// use it through the keyvalue_storage
+	/// </summary>
+	template <typename key_type, typename value_type >
+	class flat_index final
+	{
+	public:
+		using	mapped_type = value_type;
+		using	char_type = typename key_type::value_type;
+		using	key_view = std::basic_string_view<char_type>;
+		using	value_vector = std::vector< value_type >;
+
+		/// reads scan the tail linearly, thus it is kept short
+		constexpr static std::size_t tail_max = 0x400;
+
+	private:
+		struct entry final {
+			std::uint32_t offset{};
+			std::uint32_t size{};
+			value_type value{};
+		};
+		using entries = std::vector<entry>;
+
+		key_type pool_{};
+		entries body_{};
+		// sorted, the tails merged, not yet in the body
+		entries run_{};
+		// single adds are appended to the tail, unsorted, O(1)
+		entries tail_{};
+
+		key_view key_of_(entry const & entry_) const noexcept {
+			return key_view(pool_.data() + entry_.offset, entry_.size);
+		}
+
+		typename entries::const_iterator lower_bound_(entries const & entries_, key_view key_) const noexcept
+		{
+			return std::lower_bound(entries_.begin(), entries_.end(), key_,
+				[this](entry const & entry_, key_view k_) { return key_of_(entry_) < k_; });
+		}
+
+
+		// std::merge is stable, the left goes first
+		void merge_into_(entries & left_, entries & right_)
+		{
+			entries merged_{};
+			merged_.reserve(left_.size() + right_.size());
+			std::merge(
+				std::make_move_iterator(left_.begin()), std::make_move_iterator(left_.end()),
+				std::make_move_iterator(right_.begin()), std::make_move_iterator(right_.end()),
+				std::back_inserter(merged_),
+				[this](entry const & left_, entry const & right_) { return key_of_(left_) < key_of_(right_); }
+			);
+			left_.swap(merged_);
+			right_.clear();
+		}
+
+		// the tail is sorted into the run, the big run into the body
+		void merge_tail_()
+		{
+			std::stable_sort(tail_.begin(), tail_.end(),
+				[this](entry const & left_, entry const & right_) { return key_of_(left_) < key_of_(right_); });
+			merge_into_(run_, tail_);
+			if (run_.size() > (std::max)(tail_max, body_.size() / 8))
+				merge_into_(body_, run_);
+		}
+
+	public:
+		flat_index() = default;
+		flat_index(flat_index const &) = default;
+		flat_index & operator = (flat_index const &) = default;
+
+		flat_index(flat_index && other_) noexcept { swap(other_); }
+
+		flat_index & operator = (flat_index && other_) noexcept {
+			flat_index gone_{};
+			swap(gone_);
+			swap(other_);
+			return *this;
+		}
+
+		void swap(flat_index & other_) noexcept {
+			pool_.swap(other_.pool_);
+			body_.swap(other_.body_);
+			run_.swap(other_.run_);
+			tail_.swap(other_.tail_);
+		}
+
+		const size_t size() const noexcept { return body_.size() + run_.size() + tail_.size(); }
+		const bool empty() const noexcept { return size() < 1; }
+
+		void clear() noexcept {
+			pool_.clear(); body_.clear(); run_.clear(); tail_.clear();
+		}
+
+		/// <summary>
+		/// as in std::multimap, equal keys are added after the existing ones
+		/// amortized O(1) for the sorted input, see the flat_index notes for the rest
+		/// </summary>
+		void insert(std::pair<key_type, value_type> const & pair_)
+		{
+			_ASSERTE((pool_.size() + pair_.first.size()) < UINT32_MAX);
+			const key_view key_(pair_.first);
+			entry entry_{ std::uint32_t(pool_.size()), std::uint32_t(key_.size()), pair_.second };
+			pool_.append(key_);
+			// sorted input goes straight to the body
+			if (tail_.empty() && run_.empty() && (body_.empty() || !(key_ < key_of_(body_.back())))) {
+				body_.push_back(std::move(entry_));
+				return;
+			}
+			tail_.push_back(std::move(entry_));
+			if (tail_.size() > tail_max) merge_tail_();
+		}
+
+		/// <summary>
+		/// sort and merge the tail and the run into the body now
+		/// after it, reads are one binary search only
+		/// </summary>
+		void seal()
+		{
+			if (!tail_.empty()) merge_tail_();
+			if (!run_.empty()) merge_into_(body_, run_);
+		}
+
+		/// <summary>
+		/// visit the entries in the keys order, beginning from the first key
+		/// not less than from_, while in_range_ holds
+		/// in_range_ is bool (key_view), true for one run of the keys from from_
+		/// the body and the run are binary searched, the tail is scanned,
+		/// the three are walked together, equal keys in the order of adding
+		/// callback is bool (key_view, value_type const &), false stops the walk
+		/// </summary>
+		template<typename R, typename F>
+		void walk(key_view from_, R in_range_, F callback_) const
+		{
+			// the few tail entries in the range, in the keys order
+			std::vector<entry const *> tail_range_{};
+			for (entry const & entry_ : tail_) {
+				const key_view key_ = key_of_(entry_);
+				if (!(key_ < from_) && in_range_(key_)) tail_range_.push_back(&entry_);
+			}
+			std::stable_sort(tail_range_.begin(), tail_range_.end(),
+				[this](entry const * left_, entry const * right_) { return key_of_(*left_) < key_of_(*right_); });
+
+			auto body_walker_ = lower_bound_(body_, from_);
+			auto run_walker_ = lower_bound_(run_, from_);
+			auto tail_walker_ = tail_range_.begin();
+			for (;;)
+			{
+				entry const * next_{};
+				if (body_walker_ != body_.end() && in_range_(key_of_(*body_walker_)))
+					next_ = &*body_walker_;
+				if (run_walker_ != run_.end() && in_range_(key_of_(*run_walker_)) &&
+					(!next_ || key_of_(*run_walker_) < key_of_(*next_)))
+					next_ = &*run_walker_;
+				if (tail_walker_ != tail_range_.end() &&
+					(!next_ || key_of_(**tail_walker_) < key_of_(*next_)))
+					next_ = *tail_walker_;
+				if (!next_) return;
+
+				if (tail_walker_ != tail_range_.end() && next_ == *tail_walker_) ++tail_walker_;
+				else if (run_walker_ != run_.end() && next_ == &*run_walker_) ++run_walker_;
+				else ++body_walker_;
+				if (!callback_(key_of_(*next_), next_->value)) return;
+			}
+		}
+
+		/// <summary>
+		/// the sorted pairs are merged in, O(N + M)
+		/// the new pool holds the keys in the keys order
+		/// equal keys, the ones already in the index go first
+		/// </summary>
+		template<typename pair_vector>
+		void merge_sorted(pair_vector && sorted_)
+		{
+			seal();
+			std::size_t pool_size_ = pool_.size();
+			for (auto const & pair_ : sorted_) pool_size_ += pair_.first.size();
+			_ASSERTE(pool_size_ < UINT32_MAX);
+
+			key_type pool_next_{};
+			pool_next_.reserve(pool_size_);
+			entries body_next_{};
+			body_next_.reserve(body_.size() + sorted_.size());
+			auto push_ = [&](key_view key_, value_type && value_) {
+				body_next_.push_back(entry{ std::uint32_t(pool_next_.size()), std::uint32_t(key_.size()), std::move(value_) });
+				pool_next_.append(key_);
+			};
+
+			auto old_ = body_.begin();
+			auto new_ = sorted_.begin();
+			while (old_ != body_.end() || new_ != sorted_.end())
+			{
+				if (new_ == sorted_.end() ||
+					(old_ != body_.end() && !(key_view(new_->first) < key_of_(*old_)))) {
+					push_(key_of_(*old_), std::move(old_->value));
+					++old_;
+				}
+				else {
+					push_(new_->first, std::move(new_->second));
+					++new_;
+				}
+			}
+			pool_.swap(pool_next_);
+			body_.swap(body_next_);
+		}
+
+		/// the key part of the pool, the entries of the body and of the tail
+		std::size_t memory_used() const noexcept {
+			return pool_.capacity() * sizeof(char_type) +
+				(body_.capacity() + run_.capacity() + tail_.capacity()) * sizeof(entry);
+		}
+	}; // eof flat_index
+
+	namespace inner {
+		template<typename key_type, typename value_type, typename char_type, typename F>
+		bool visit_exact(const flat_index<key_type, value_type> & index_, std::basic_string_view<char_type> query, F && callback_)
+		{
+			bool stopped_{};
+			index_.walk(query,
+				[&](auto key_) { return key_ == query; },
+				[&](auto key_, value_type const & value_) { return !(stopped_ = !callback_(key_, value_)); });
+			return !stopped_;
+		}
+
+		template<typename key_type, typename value_type, typename char_type, typename F>
+		bool visit_prefix(const flat_index<key_type, value_type> & index_, std::basic_string_view<char_type> prefix_, F && callback_)
+		{
+			bool stopped_{};
+			index_.walk(prefix_,
+				[&](auto key_) { return key_.substr(0, prefix_.size()) == prefix_; },
+				[&](auto key_, value_type const & value_) { return !(stopped_ = !callback_(key_, value_)); });
+			return !stopped_;
+		}
+
+		/// the callback gets std::pair< key_view, value_type const & >
+		template<typename key_type, typename value_type, typename F>
+		F for_each_element(const flat_index<key_type, value_type> & index_, F callback_)
+		{
+			using key_view = typename flat_index<key_type, value_type>::key_view;
+			index_.walk(key_view{}, [](key_view) { return true; }, [&](key_view key_, value_type const & value_) {
+				callback_(std::pair<key_view, value_type const &>(key_, value_));
+				return true;
+			});
+			return callback_;
+		}
+
+		template<typename key_type, typename value_type >
+		std::size_t memory_used(const flat_index<key_type, value_type> & index_) noexcept
+		{
+			return index_.memory_used();
+		}
+
+		template<typename key_type, typename value_type, typename pair_vector >
+		void merge_sorted(flat_index<key_type, value_type> & index_, pair_vector && sorted_)
+		{
+			index_.merge_sorted(std::forward<pair_vector>(sorted_));
+		}
+
+		template<typename key_type, typename value_type, typename char_type, typename F>
+		bool visit_exact(const art_index<key_type, value_type> & index_, std::basic_string_view<char_type> query, F && callback_)
+		{
+			return index_.walk_exact(query, std::ref(callback_));
+		}
+
+		template<typename key_type, typename value_type, typename char_type, typename F>
+		bool visit_prefix(const art_index<key_type, value_type> & index_, std::basic_string_view<char_type> prefix_, F && callback_)
+		{
+			return index_.walk_prefix(prefix_, std::ref(callback_));
+		}
+
+		/// the callback gets std::pair< key_view, value_type const & >
+		template<typename key_type, typename value_type, typename F>
+		F for_each_element(const art_index<key_type, value_type> & index_, F callback_)
+		{
+			using key_view = typename art_index<key_type, value_type>::key_view;
+			index_.walk_prefix(key_view{}, [&](key_view key_, value_type const & value_) {
+				callback_(std::pair<key_view, value_type const &>(key_, value_));
+				return true;
+			});
+			return callback_;
+		}
+
+		template<typename key_type, typename value_type >
+		std::size_t memory_used(const art_index<key_type, value_type> & index_) noexcept
+		{
+			return index_.memory_used();
+		}
+
+		/// the radix tree has no cheaper build, the inserts are O(key length) each
+		template<typename key_type, typename value_type, typename pair_vector >
+		void merge_sorted(art_index<key_type, value_type> & index_, pair_vector && sorted_)
+		{
+			for (auto const & pair_ : sorted_) index_.insert(pair_);
+		}
+
+		/// the tree is the same whatever the order of inserts, thus no sorting
+		template<typename key_type, typename value_type >
+		struct bulk_needs_sort< art_index<key_type, value_type> > : std::false_type {};
+
+		/*
+		2019-04-12	dbj@dbj.org
+		the queries over all the backends
+		at most max_results values are visited, the visit stops there
+		*/
+		template<typename storage_type, typename char_type, typename F>
+		std::size_t visit_query(
+			const storage_type & key_value_storage_,
+			std::basic_string_view<char_type> query,
+			bool find_by_prefix,
+			std::size_t max_results,
+			F && callback_
+		)
+		{
+			std::size_t visited_{};
+			if (max_results < 1) return visited_;
+			auto limited_ = [&](std::basic_string_view<char_type> key_, auto const & value_) {
+				++visited_;
+				if constexpr (std::is_void_v<decltype(callback_(key_, value_))>) {
+					callback_(key_, value_);
+				}
+				else {
+					if (!callback_(key_, value_)) return false;
+				}
+				return visited_ < max_results;
+			};
+			if (find_by_prefix)
+				visit_prefix(key_value_storage_, query, limited_);
+			else
+				visit_exact(key_value_storage_, query, limited_);
+			return visited_;
+		}
+
+		template<typename storage_type, typename char_type,
+			typename value_vector = std::vector< typename storage_type::mapped_type > >
+		value_vector
+			exact_match_query(const storage_type & key_value_storage_,
+				std::basic_string_view<char_type> query, std::size_t max_results = SIZE_MAX)
+		{
+			value_vector retvec{};
+			visit_query(key_value_storage_, query, false, max_results,
+				[&](auto, auto const & value_) { retvec.push_back(value_); });
+			return retvec;
+		}
+
+		template<typename storage_type, typename char_type,
+			typename value_vector = std::vector< typename storage_type::mapped_type > >
+		value_vector
+			prefix_match_query(const storage_type & key_value_storage_,
+				std::basic_string_view<char_type> prefix_, std::size_t max_results = SIZE_MAX)
+		{
+			value_vector retvec{};
+			visit_query(key_value_storage_, prefix_, true, max_results,
+				[&](auto, auto const & value_) { retvec.push_back(value_); });
+			return retvec;
+		}
+	} // inner
+
+	/// <summary>
+	/// the storage policies of the keyvalue_storage
+	/// </summary>
+	namespace backend {
+		/// the default, std::multimap, std::less<> makes it searchable by the views
+		struct multimap final {
+			template<typename key_type, typename value_type>
+			using type = std::multimap< key_type, value_type, std::less<> >;
+		};
+		/*
+		the flat_index, for the bulk loaded, read mostly storages and the prefix queries
+		use bulk_load() to fill it, single adds are buffered and put in order
+		by the adds, in steps, thus the queries are never blocked by the sorting
+		*/
+		struct flat final {
+			template<typename key_type, typename value_type>
+			using type = flat_index< key_type, value_type >;
+		};
+		/// the adaptive radix tree, for the large key sets with the long shared prefixes
+		struct art final {
+			template<typename key_type, typename value_type>
+			using type = art_index< key_type, value_type >;
+		};
+	} // backend
+
+	template <typename value_type, typename key_type = std::wstring, typename BACKEND = backend::multimap >
 	class __declspec(novtable)  keyvalue_storage final
 	{
 #ifdef _DBJ_MT_
-		using lock_unlock = dbj::sync::lock_unlock;
+		/*
+		2019-04-08	dbj@dbj.org
+		readers share the lock, and run in parallel
+		add, clear and swap are exclusive
+		NOTE: callback given to for_each() must not add to the same storage
+		*/
+		using lock_type = dbj::sync::rw_lock<>;
+		using reader_lock = std::shared_lock<lock_type>;
+		using writer_lock = std::lock_guard<lock_type>;
 #endif
 	public:
 
@@ -29,9 +591,10 @@ namespace dbj::storage {
 			dbj::is_std_string_v<key_type> , "dbj::storage requires key to be of std string type"
 			);
 
-		using	storage_type = std::multimap< key_type, value_type >;
-		using   iterator = typename storage_type::iterator;
+		using	storage_type = typename BACKEND::template type< key_type, value_type >;
+		using   iterator = typename inner::iterator_of<storage_type>::type;
 		using	value_vector = std::vector< value_type >;
+		using	key_view = std::basic_string_view< typename key_type::value_type >;
 
 		/// <summary>
 		/// the aim is to be able to use instances of this class as values
@@ -41,24 +604,58 @@ namespace dbj::storage {
 		friend void swap(keyvalue_storage & left_, keyvalue_storage & right_)	noexcept
 		{
 #ifdef _DBJ_MT_
-			lock_unlock padlock{};
+			if (&left_ == &right_) return;
+			std::scoped_lock<lock_type, lock_type> padlock{ left_.lock_, right_.lock_ };
 #endif
 			std::swap(left_.key_value_storage_, right_.key_value_storage_);
 		}
 
+#ifdef _DBJ_MT_
+		/// <summary>
+		/// the lock is not copied, the storage is copied under the readers lock
+		/// </summary>
+		keyvalue_storage() = default;
+
+		keyvalue_storage(const keyvalue_storage & other_)
+			: key_value_storage_(other_.copy_())
+		{}
+
+		keyvalue_storage & operator = (const keyvalue_storage & other_)
+		{
+			if (&other_ != this) {
+				storage_type copy_ = other_.copy_();
+				writer_lock padlock{ lock_ };
+				key_value_storage_.swap(copy_);
+			}
+			return *this;
+		}
+
+		keyvalue_storage(keyvalue_storage && other_) noexcept
+		{
+			writer_lock padlock{ other_.lock_ };
+			key_value_storage_.swap(other_.key_value_storage_);
+		}
+
+		keyvalue_storage & operator = (keyvalue_storage && other_) noexcept
+		{
+			swap(*this, other_);
+			return *this;
+		}
+#endif
+
 		/// <summary>
 		/// clear the storage held
 		/// </summary>
 		void clear() const {
 #ifdef _DBJ_MT_
-			lock_unlock padlock{};
+			writer_lock padlock{ lock_ };
 #endif
 			key_value_storage_.clear();
 		}
 
 		const size_t size() const noexcept {
 #ifdef _DBJ_MT_
-			lock_unlock padlock{};
+			reader_lock padlock{ lock_ };
 #endif
 			return this->key_value_storage_.size();
 		}
@@ -68,19 +665,25 @@ namespace dbj::storage {
 		/// storage_type::value_type
 		/// which in turn is pair 
 		/// wstring is the key, T is the value
+		/// for the backend::flat and backend::art, the key is the string view
 		/// NOTE: no exception caught in here
 		/// </summary>
 		template< typename F>
 		const auto for_each(F callback_) const noexcept {
 #ifdef _DBJ_MT_
-			lock_unlock padlock{};
+			reader_lock padlock{ lock_ };
 #endif
-			return
-				std::for_each(
-					this->key_value_storage_.begin(),
-					this->key_value_storage_.end(),
-					callback_
-				);
+			return inner::for_each_element(this->key_value_storage_, callback_);
+		}
+
+		/// <summary>
+		/// bytes used by the backend, estimated for the std::multimap
+		/// </summary>
+		const size_t memory_used() const noexcept {
+#ifdef _DBJ_MT_
+			reader_lock padlock{ lock_ };
+#endif
+			return inner::memory_used(this->key_value_storage_);
 		}
 
 		/// <summary>
@@ -88,7 +691,7 @@ namespace dbj::storage {
 		/// </summary>
 		const bool empty() const noexcept {
 #ifdef _DBJ_MT_
-			lock_unlock padlock{};
+			reader_lock padlock{ lock_ };
 #endif
 			return this->key_value_storage_.size() < 1;
 		}
@@ -96,11 +699,12 @@ namespace dbj::storage {
 		/// <summary>
 		/// add new K/V pair
 		/// return the iterator to them just inserted
+		/// backend::flat and backend::art return nothing
 		/// </summary>
 		auto add( const key_type & key, const value_type & value) const
 		{
 #ifdef _DBJ_MT_
-			lock_unlock padlock{};
+			writer_lock padlock{ lock_ };
 #endif
 			_ASSERTE(false == key.empty());
 			return key_value_storage_.insert( std::make_pair(key,value) );
@@ -111,98 +715,419 @@ namespace dbj::storage {
 		/// </summary>
 		void sort() const noexcept = delete;
 
+		/// <summary>
+		/// 2019-04-13	dbj@dbj.org
+		/// add all the pairs from the range, { key, value } each
+		/// the pairs are sorted once, in parallel when there are many of them
+		/// and merged into the storage in O(N + M), the lock is taken once
+		/// backend::art takes them unsorted, one insert is O(key length) anyway
+		/// equal keys keep the range order, as if added one by one
+		/// <code>
+		///  std::vector< std::pair<std::string, int> > pairs_ = read_them_all() ;
+		///  kvs.bulk_load( pairs_ ) ;
+		/// </code>
+		/// </summary>
+		template< typename RANGE >
+		void bulk_load(RANGE const & range_) const
+		{
+			std::vector< std::pair<key_type, value_type> > pairs_{};
+			for (auto const & pair_ : range_) {
+				_ASSERTE(false == key_view(pair_.first).empty());
+				pairs_.emplace_back(pair_.first, pair_.second);
+			}
+			if constexpr (inner::bulk_needs_sort<storage_type>::value)
+				inner::sort_pairs(pairs_);
+#ifdef _DBJ_MT_
+			writer_lock padlock{ lock_ };
+#endif
+			inner::merge_sorted(key_value_storage_, std::move(pairs_));
+		}
+
+		/// <summary>
+		/// add all from the other storage, which is already sorted
+		/// thus no sorting, just the O(N + M) merge
+		/// the other is copied under its readers lock, then merged under
+		/// the writers lock of this one, the two are never held together
+		/// </summary>
+		template< typename OTHER_BACKEND >
+		void merge(const keyvalue_storage<value_type, key_type, OTHER_BACKEND> & other_) const
+		{
+			std::vector< std::pair<key_type, value_type> > sorted_{};
+			sorted_.reserve(other_.size());
+			other_.for_each([&](auto const & pair_) { sorted_.emplace_back(pair_.first, pair_.second); });
+#ifdef _DBJ_MT_
+			writer_lock padlock{ lock_ };
+#endif
+			inner::merge_sorted(key_value_storage_, std::move(sorted_));
+		}
+
+		/// <summary>
+		/// 2019-04-12	dbj@dbj.org
+		/// visit the matching values in the keys order, nothing is copied
+		/// the callback is (key_view, value_type const &) and returns nothing,
+		/// or bool where false stops the visit
+		/// at most max_results are visited, the work done is proportional
+		/// to them, not to the count of all the keys matching
+		/// returns the number of values visited
+		/// NOTE: the readers lock is held, callback must not add to the same storage
+		/// <code>
+		///  // autocomplete, top ten
+		///  kvs.visit("alp", [&](auto key_, auto const & value_) { show(key_, value_); }, true, 10) ;
+		/// </code>
+		/// </summary>
+		template< typename F>
+		size_t visit(
+			key_view		query,
+			F				callback_,
+			bool			find_by_prefix = true,
+			size_t			max_results = SIZE_MAX
+		) const
+		{
+#ifdef _DBJ_MT_
+			reader_lock padlock{ lock_ };
+#endif
+			return inner::visit_query(key_value_storage_, query, find_by_prefix, max_results, callback_);
+		}
+
 		/// <summary>
 		/// if find_by_prefix is false the exact key match should  be performed
 		/// if true all the keys matching are going into the result
+		/// at most maxResults of them, in the keys order
 		/// </summary>
 		value_vector
 			retrieve(
-				key_type		query,
+				key_view		query,
 				bool			find_by_prefix = true,
-				/* currently we ignore maxResults */
-				unsigned		DBJ_MAYBE(maxResults) = ULONG_MAX
+				unsigned		maxResults = ULONG_MAX
 			) const
 		{
 #ifdef _DBJ_MT_
-			lock_unlock padlock{};
+			reader_lock padlock{ lock_ };
 #endif
-			value_vector retval_{};
-			if (key_value_storage_.size() < 1)
-				return retval_;
+			// the prefix match includes the exact one
+			if (true == find_by_prefix)
+				return inner::prefix_match_query(key_value_storage_, query, maxResults);
+
+			return inner::exact_match_query(key_value_storage_, query, maxResults);
+		}
+
+	private:
+#ifdef _DBJ_MT_
+		storage_type copy_() const
+		{
+			reader_lock padlock{ lock_ };
+			return key_value_storage_;
+		}
 
-			if (true == find_by_prefix) {
-				retval_ = prefix_match_query(query);
+		mutable lock_type lock_{};
+#endif
+		// and at last the storage itself
+		mutable storage_type key_value_storage_{};
+
+	}; // eof keyvalue_storage 
+
+	/// <summary>
+	/// 2019-04-08	dbj@dbj.org
+	/// lock striped storage, for heavy concurrent add() traffic
+	/// always thread safe, _DBJ_MT_ or not
+	/// each key lives in one of the SHARDS, selected by its hash
+	/// each shard has its own reader-writer lock, thus adds of different
+	/// keys mostly do not wait on each other
+	/// exact match visits one shard, prefix match visits all of them,
+	/// and its result is in the keys order, as with keyvalue_storage
+	/// </summary>
+	template <typename value_type, typename key_type = std::wstring, std::size_t SHARDS = 16 >
+	class __declspec(novtable)  sharded_storage final
+	{
+	public:
+		static_assert(
+			dbj::is_std_string_v<key_type>, "dbj::storage requires key to be of std string type"
+			);
+		static_assert(SHARDS > 0, "dbj::storage::sharded_storage requires at least one shard");
 
-				if (retval_.size() < 1)
-					find_by_prefix = false;
+		using	storage_type = std::multimap< key_type, value_type, std::less<> >;
+		using	value_vector = std::vector< value_type >;
+		using	key_view = std::basic_string_view< typename key_type::value_type >;
+		constexpr static std::size_t shards_count = SHARDS;
+
+	private:
+		using lock_type = dbj::sync::rw_lock<>;
+		using reader_lock = std::shared_lock<lock_type>;
+		using writer_lock = std::lock_guard<lock_type>;
+
+		// one cache line at least, the neighbouring locks do not share it
+		struct alignas(64) shard final {
+			mutable lock_type lock{};
+			storage_type storage{};
+		};
+
+		shard & shard_of_(const key_type & key_) const noexcept
+		{
+			return shards_[std::hash<key_type>{}(key_) % SHARDS];
+		}
+
+	public:
+		sharded_storage() = default;
+		sharded_storage(const sharded_storage &) = delete;
+		sharded_storage & operator = (const sharded_storage &) = delete;
+
+		void add(const key_type & key, const value_type & value) const
+		{
+			_ASSERTE(false == key.empty());
+			shard & shard_ = shard_of_(key);
+			writer_lock padlock{ shard_.lock };
+			shard_.storage.insert(std::make_pair(key, value));
+		}
+
+		void clear() const
+		{
+			for (shard & shard_ : shards_) {
+				writer_lock padlock{ shard_.lock };
+				shard_.storage.clear();
 			}
+		}
 
-			if (false == find_by_prefix) {
-				retval_ = exact_match_query(query);
+		/// <summary>
+		/// concurrent adds are not waited for
+		/// the sum is of each shard at the time it was visited
+		/// </summary>
+		const size_t size() const noexcept
+		{
+			size_t size_{};
+			for (shard const & shard_ : shards_) {
+				reader_lock padlock{ shard_.lock };
+				size_ += shard_.storage.size();
 			}
-			return retval_;
+			return size_;
 		}
 
-	private:
-		/* do not use as public in this form */
+		const bool empty() const noexcept { return size() < 1; }
+
+		/// <summary>
+		/// the argument of the callback is the storage_type::value_type
+		/// NOTE: shard by shard, thus not in the keys order
+		/// callback must not add to the same storage
+		/// </summary>
+		template< typename F>
+		void for_each(F callback_) const
+		{
+			for (shard const & shard_ : shards_) {
+				reader_lock padlock{ shard_.lock };
+				std::for_each(shard_.storage.begin(), shard_.storage.end(), callback_);
+			}
+		}
+
+		/// <summary>
+		/// as keyvalue_storage::retrieve
+		/// if find_by_prefix is false the exact key match should  be performed
+		/// if true all the keys matching are going into the result
+		/// at most maxResults of them, in the keys order
+		/// </summary>
 		value_vector
-			exact_match_query(
-				// must be lower case!
-				key_type query
+			retrieve(
+				key_view		query,
+				bool			find_by_prefix = true,
+				unsigned		maxResults = ULONG_MAX
 			) const
 		{
-			/// <summary>
-			/// general question is why is vector of values returned?
-			/// vector of keys is lighter
-			/// </summary>
-			value_vector retvec{};
+			// the prefix match includes the exact one
+			if (true == find_by_prefix)
+				return prefix_match_query(query, maxResults);
+			return exact_match_query(query, maxResults);
+		}
 
-			auto range = key_value_storage_.equal_range(query);
-			if (range.first == key_value_storage_.end()) return retvec;
+	private:
+		value_vector exact_match_query(key_view query, std::size_t max_results) const
+		{
+			// the same hash for the key and for its view
+			shard const & shard_ = shards_[std::hash<key_view>{}(query) % SHARDS];
+			reader_lock padlock{ shard_.lock };
+			return inner::exact_match_query(shard_.storage, query, max_results);
+		}
 
-			std::transform(
-				range.first,
-				range.second,
-				std::back_inserter(retvec),
-				[](typename storage_type::value_type element) { return element.second; }
-			);
+		value_vector prefix_match_query(key_view prefix_, std::size_t max_results) const
+		{
+			// pointers are stable while the shard is locked, not after
+			// thus the copies are collected, at most max_results from each shard
+			std::vector< std::pair<key_type, value_type> > found_{};
+			for (shard const & shard_ : shards_) {
+				reader_lock padlock{ shard_.lock };
+				inner::visit_query(shard_.storage, prefix_, true, max_results,
+					[&](key_view key_, value_type const & value_) { found_.emplace_back(key_, value_); });
+			}
+			// back to the keys order, equal keys keep their shard order
+			std::stable_sort(found_.begin(), found_.end(),
+				[](auto const & left_, auto const & right_) { return left_.first < right_.first; });
+			if (found_.size() > max_results) found_.resize(max_results);
+
+			value_vector retvec{};
+			retvec.reserve(found_.size());
+			for (auto & pair_ : found_)
+				retvec.push_back(std::move(pair_.second));
 			return retvec;
 		}
 
-		/* do not use as public in this form */
-		value_vector
-			prefix_match_query(	key_type prefix_ ) const
+		mutable std::array<shard, SHARDS> shards_{};
+
+	}; // eof sharded_storage
+
+	/// <summary>
+	/// 2019-04-09	dbj@dbj.org
+	/// read-copy-update, for the read mostly storages
+	/// readers take the immutable, versioned snapshot with one atomic load,
+	/// and query it with no locks at all
+	/// writers batch the changes and publish the new snapshot
+	/// the old snapshot is gone when its last reader drops it
+	/// <code>
+	///  snapshot_storage<int, std::string> dict_ ;
+	///  // writer
+	///  auto batch_ = dict_.make_batch() ;
+	///  batch_.add("alpha", 1).add("beta", 2) ;
+	///  dict_.publish( std::move(batch_) ) ;
+	///  // reader
+	///  auto snap_ = dict_.load() ;
+	///  auto values_ = snap_.retrieve("al") ;
+	/// </code>
+	/// </summary>
+	template <typename value_type, typename key_type = std::wstring >
+	class __declspec(novtable)  snapshot_storage final
+	{
+	public:
+		static_assert(
+			dbj::is_std_string_v<key_type>, "dbj::storage requires key to be of std string type"
+			);
+
+		using	storage_type = std::multimap< key_type, value_type, std::less<> >;
+		using	value_vector = std::vector< value_type >;
+		using	key_view = std::basic_string_view< typename key_type::value_type >;
+
+	private:
+		struct published final {
+			storage_type storage{};
+			std::uint64_t version{};
+		};
+		using published_ptr = std::shared_ptr<const published>;
+
+	public:
+		/// <summary>
+		/// immutable, cheap to copy, keeps its version alive
+		/// </summary>
+		class snapshot final
 		{
-			/// <summary>
-			/// general question is why is vector of values returned?
-			/// vector of keys is lighter
-			/// </summary>
-			value_vector retvec{};
-			typename storage_type::iterator && walker_ 
-				= this->key_value_storage_.upper_bound(prefix_);
+			published_ptr data_{};
+			friend class snapshot_storage;
+			explicit snapshot(published_ptr data_arg_) noexcept : data_(std::move(data_arg_)) {}
+		public:
+			std::uint64_t version() const noexcept { return data_->version; }
+			const size_t size() const noexcept { return data_->storage.size(); }
+			const bool empty() const noexcept { return data_->storage.size() < 1; }
+
+			/// the argument of the callback is the storage_type::value_type
+			template< typename F>
+			void for_each(F callback_) const {
+				std::for_each(data_->storage.begin(), data_->storage.end(), callback_);
+			}
 
-			while (walker_ != key_value_storage_.end())
+			/// as keyvalue_storage::visit, no locks
+			template< typename F>
+			size_t visit(key_view query, F callback_, bool find_by_prefix = true, size_t max_results = SIZE_MAX) const
 			{
-				// if prefix of the current key add its value to the result
-				const key_type & walker_key = walker_->first;
-				if (
-					dbj::str::is_prefix( prefix_.c_str(), walker_key.c_str())
-					) 
-				{
-					retvec.push_back(walker_->second);
-					// advance the iterator 
-					walker_++;
-				}
-				else {
-					break;
-				}
+				return inner::visit_query(data_->storage, query, find_by_prefix, max_results, callback_);
 			}
-			return retvec;
+
+			/// as keyvalue_storage::retrieve
+			value_vector
+				retrieve(
+					key_view		query,
+					bool			find_by_prefix = true,
+					unsigned		maxResults = ULONG_MAX
+				) const
+			{
+				// the prefix match includes the exact one
+				if (true == find_by_prefix)
+					return inner::prefix_match_query(data_->storage, query, maxResults);
+				return inner::exact_match_query(data_->storage, query, maxResults);
+			}
+		};
+
+		/// <summary>
+		/// the changes, applied in order at the publishing
+		/// </summary>
+		class batch final
+		{
+			friend class snapshot_storage;
+			std::vector< std::pair<key_type, value_type> > adds_{};
+			bool clear_{};
+			batch() = default;
+		public:
+			batch & add(const key_type & key, const value_type & value) {
+				_ASSERTE(false == key.empty());
+				adds_.emplace_back(key, value);
+				return *this;
+			}
+			// everything published so far and added so far is dropped
+			batch & clear() noexcept {
+				adds_.clear();
+				clear_ = true;
+				return *this;
+			}
+			size_t size() const noexcept { return adds_.size(); }
+		};
+
+		snapshot_storage() : current_(std::make_shared<const published>()) {}
+		snapshot_storage(const snapshot_storage &) = delete;
+		snapshot_storage & operator = (const snapshot_storage &) = delete;
+
+		/// <summary>
+		/// one atomic load, no locks
+		/// </summary>
+		snapshot load() const noexcept
+		{
+#ifdef DBJ_KVS_ATOMIC_SHARED_PTR
+			return snapshot{ current_.load(std::memory_order_acquire) };
+#else
+			return snapshot{ std::atomic_load_explicit(&current_, std::memory_order_acquire) };
+#endif
 		}
-		// and at last the storage itself
-		mutable storage_type key_value_storage_{};
 
-	}; // eof keyvalue_storage 
+		batch make_batch() const { return batch{}; }
+
+		/// <summary>
+		/// the new snapshot is the current one with the batch applied
+		/// writers are serialized, readers never wait
+		/// returns the version published
+		/// </summary>
+		std::uint64_t publish(batch && batch_)
+		{
+			std::lock_guard<std::mutex> padlock{ writer_ };
+			snapshot current_snap_ = load();
+
+			auto next_ = std::make_shared<published>();
+			if (!batch_.clear_)
+				next_->storage = current_snap_.data_->storage;
+			inner::sort_pairs(batch_.adds_);
+			inner::merge_sorted(next_->storage, std::move(batch_.adds_));
+			next_->version = current_snap_.version() + 1;
+
+			const std::uint64_t version_ = next_->version;
+			published_ptr next_const_ = std::move(next_);
+#ifdef DBJ_KVS_ATOMIC_SHARED_PTR
+			current_.store(std::move(next_const_), std::memory_order_release);
+#else
+			std::atomic_store_explicit(&current_, std::move(next_const_), std::memory_order_release);
+#endif
+			batch_.adds_.clear();
+			return version_;
+		}
+
+	private:
+		std::mutex writer_{};
+#ifdef DBJ_KVS_ATOMIC_SHARED_PTR
+		std::atomic<published_ptr> current_;
+#else
+		published_ptr current_;
+#endif
+	}; // eof snapshot_storage
 
 } //  namespace
 
@@ -308,9 +308,7 @@ namespace dbj {
 			inline void
 			secure_zero(void *s, size_t n)
 		{
-#ifdef _DBJ_MT_
-			dbj::sync::lock_unlock __dbj_auto_lock__;
-#endif // _DBJ_MT_
+			// no lock, the caller owns the memory, nothing is shared
 			volatile char *p = (char *)s;
 			while (n--) *p++ = 0;
 		}